@@ -21,6 +21,10 @@
 // You may choose to define on your own the following:
 //
 // 	- DATAREFW_ASSERT(cond)			// - Custom assert function
+// 	- DATAREFW_NO_SIMD			// - Plain loops for int/float array conversion
+// 	- DATAREFW_INSTRUMENT			// - Count XPLM calls per dataref, see dataref_call_stats()
+// 	- DATAREFW_INSTRUMENT_TIMING		// - Also time them (implies DATAREFW_INSTRUMENT)
+// 	- DATAREFW_INSTRUMENT_CALLBACKS		// - Latency histograms for CreateDataref callbacks
 //
 // The main types associated with datarefs are what are supported, if you try
 // to use an unsupported type, you'll get a compile-time assertion failure.
@@ -32,19 +36,59 @@
 //		DrIntArr (std::vector<int>)
 //		DrFloatArr (std::vector<float>)
 //		std::string
+//		std::array<int, N>, std::array<float, N> (FindDataref only)
+//		FixedString<N> (CreateDataref only)
+//
+// A FindDataref's path can also be fixed at compile time, which checks it
+// while compiling and shares one handle per path across the whole program:
+//
+//	FindDataref<float, "sim/flightmodel/position/indicated_airspeed"_dr> ias;	// C++20
+//
+//	DATAREFW_PATH(ias_path, "sim/flightmodel/position/indicated_airspeed");	// C++11
+//	FindDataref<float, &ias_path::slot> ias;
 
 #ifndef DATAREFW_H
 #define DATAREFW_H
 
 #include <XPLMDataAccess.h>
+#include <XPLMProcessing.h>
 #include <XPLMUtilities.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <type_traits>
+#include <cstdint>
+#include <cstdio>
 #include <string>
+#include <thread>
 #include <cstring>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if !IBM
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#if !defined(DATAREFW_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+# define DATAREFW_SSE2 1
+# include <emmintrin.h>
+#endif
+#if !defined(DATAREFW_NO_SIMD) && defined(__AVX__)
+# define DATAREFW_AVX 1
+# include <immintrin.h>
+#endif
+
 #define DATAREFW_UNUSED(a) (void)(a)
 
 #if (defined(__GNUC__) || defined(__clang__))
@@ -75,11 +119,158 @@
 # endif // defined(__GNUC__) || defined(__clang__)
 #endif // DATAREFW_ASSERT
 
+#if (defined(__cpp_nontype_template_args) && (__cpp_nontype_template_args >= 201911L))
+# define DATAREFW_HAS_PATH_LITERALS 1
+#endif
+
+#if (defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L))
+# if __has_include(<coroutine>)
+#  include <coroutine>
+#  include <exception>
+#  include <optional>
+#  define DATAREFW_HAS_COROUTINES 1
+# endif
+#endif
+
+#if defined(DATAREFW_INSTRUMENT_TIMING) && !defined(DATAREFW_INSTRUMENT)
+# define DATAREFW_INSTRUMENT 1
+#endif
+
+#if defined(DATAREFW_INSTRUMENT_TIMING) || defined(DATAREFW_INSTRUMENT_CALLBACKS)
+# if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  include <x86intrin.h>
+#  define DATAREFW_RDTSC 1
+# elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#  define DATAREFW_RDTSC 1
+# endif
+#endif
+
 namespace datarefw {
 
 using DrIntArr = std::vector<int>;
 using DrFloatArr = std::vector<float>;
 
+// String with inline storage for up to N chars, for CreateDataref byte
+// datarefs that must never touch the heap. Anything past N is truncated.
+template <std::size_t N>
+class FixedString {
+public:
+	using value_type = char;
+	using size_type = std::size_t;
+
+	FixedString() = default;
+
+	FixedString(const char *str) noexcept {
+		assign(str, (str != nullptr) ? std::strlen(str) : 0);
+	}
+
+	FixedString(const std::string& str) noexcept {
+		assign(str.data(), str.size());
+	}
+
+	void
+	assign(const char *str, size_type len) noexcept {
+		length = (len < N) ? len : N;
+		if (length > 0) {
+			std::memcpy(buffer.data(), str, length);
+		}
+		buffer[length] = '\0';
+	}
+
+	// Grows with '\0' padding, clamped to N.
+	void
+	resize(size_type len) noexcept {
+		len = (len < N) ? len : N;
+		if (len > length) {
+			std::memset(buffer.data() + length, 0, len - length);
+		}
+		length = len;
+		buffer[length] = '\0';
+	}
+
+	void
+	clear() noexcept {
+		resize(0);
+	}
+
+	DATAREFW_NODISCARD size_type
+	size() const noexcept {
+		return length;
+	}
+
+	DATAREFW_NODISCARD bool
+	empty() const noexcept {
+		return (length == 0);
+	}
+
+	static constexpr size_type
+	capacity() noexcept {
+		return N;
+	}
+
+	DATAREFW_NODISCARD const char *
+	c_str() const noexcept {
+		return buffer.data();
+	}
+
+	DATAREFW_NODISCARD const char *
+	data() const noexcept {
+		return buffer.data();
+	}
+
+	char&
+	operator[](size_type index) noexcept {
+		return buffer[index];
+	}
+
+	const char&
+	operator[](size_type index) const noexcept {
+		return buffer[index];
+	}
+
+	DATAREFW_NODISCARD std::string
+	str() const {
+		return std::string(buffer.data(), length);
+	}
+
+	FixedString<N>&
+	operator+=(const FixedString<N>& rhs) noexcept {
+		const auto old_len = length;
+		const auto add = (rhs.length < N - old_len) ? rhs.length : N - old_len;
+		std::memcpy(buffer.data() + old_len, rhs.buffer.data(), add);
+		length = old_len + add;
+		buffer[length] = '\0';
+		return *this;
+	}
+
+	friend bool
+	operator==(const FixedString<N>& lhs, const FixedString<N>& rhs) noexcept {
+		return (lhs.length == rhs.length &&
+			std::memcmp(lhs.buffer.data(), rhs.buffer.data(), lhs.length) == 0);
+	}
+
+	friend bool
+	operator!=(const FixedString<N>& lhs, const FixedString<N>& rhs) noexcept {
+		return !(lhs == rhs);
+	}
+
+	friend std::ostream&
+	operator<<(std::ostream& os, const FixedString<N>& obj) {
+		os.write(obj.buffer.data(), obj.length);
+		return os;
+	}
+private:
+	std::array<char, N + 1> buffer {{}};
+	size_type length { 0 };
+};
+
+template <typename U>
+struct dr_type_is_fixed_string : std::false_type {};
+
+template <std::size_t N>
+struct dr_type_is_fixed_string<FixedString<N>> : std::true_type {};
+
 template <typename U>
 struct dr_type_is_array :
 	std::integral_constant<bool,
@@ -89,7 +280,8 @@ struct dr_type_is_array :
 template <typename U>
 struct dr_type_is_byte :
 	std::integral_constant<bool,
-		std::is_same<std::string, U>::value> {};
+		std::is_same<std::string, U>::value ||
+		dr_type_is_fixed_string<U>::value> {};
 
 template <typename U>
 struct dr_type_is_number :
@@ -108,32 +300,612 @@ verify_types() {
 		std::is_same<double, T>::value     ||
 		std::is_same<DrIntArr, T>::value   ||
 		std::is_same<DrFloatArr, T>::value ||
-		std::is_same<std::string, T>::value
+		dr_type_is_byte<T>::value
 		),
 		"Unsupported Type"
 	);
 }
 
+// Whether a dataref of the given XPLM types can be accessed as T.
+template <typename T>
+DATAREFW_NODISCARD bool
+dataref_type_matches(XPLMDataTypeID types) noexcept {
+	switch (types) {
+		case xplmType_Int:
+			return std::is_same<int, T>::value;
+		case xplmType_Float:
+			return std::is_same<float, T>::value;
+		case xplmType_Double:
+			return std::is_same<double, T>::value;
+		case (xplmType_Int | xplmType_Float | xplmType_Double):
+			return dr_type_is_number<T>::value;
+		case xplmType_IntArray:
+			return std::is_same<DrIntArr, T>::value;
+		case xplmType_FloatArray:
+			return std::is_same<DrFloatArr, T>::value;
+		case (xplmType_IntArray | xplmType_FloatArray):
+			return dr_type_is_array<T>::value;
+		case xplmType_Data:
+			return std::is_same<std::string, T>::value;
+		case xplmType_Unknown:
+			return false;
+		default:
+			return true;
+	};
+}
+
+// Verify our template-provided type is correct (don't want anything weird
+// trying to access/set data).
+template <typename T>
+void
+verify_dataref_type(XPLMDataTypeID types) {
+	DATAREFW_ASSERT(dataref_type_matches<T>(types));
+}
+
+// Single-pass view over an array dataref that reads CHUNK elements per XPLM
+// call instead of one. Returned by FindDataref::chunked().
+template <typename Dr, typename V, std::size_t CHUNK>
+class ChunkedReader {
+public:
+	class iterator {
+	public:
+		iterator(ChunkedReader *preader, std::size_t pindex) noexcept
+			: reader(preader), index(pindex) {}
+
+		V
+		operator*() const {
+			return reader->impl_element(index);
+		}
+
+		iterator&
+		operator++() noexcept {
+			++index;
+			return *this;
+		}
+
+		bool
+		operator==(const iterator& rhs) const noexcept {
+			return (index == rhs.index);
+		}
+
+		bool
+		operator!=(const iterator& rhs) const noexcept {
+			return (index != rhs.index);
+		}
+	private:
+		ChunkedReader *reader;
+		std::size_t index;
+	};
+
+	ChunkedReader(const Dr& pdr, std::size_t psize) noexcept
+		: dr(pdr), total(psize) {}
+
+	iterator
+	begin() noexcept {
+		return iterator(this, 0);
+	}
+
+	iterator
+	end() noexcept {
+		return iterator(this, total);
+	}
+
+	DATAREFW_NODISCARD std::size_t
+	size() const noexcept {
+		return total;
+	}
+private:
+	V
+	impl_element(std::size_t index) {
+		DATAREFW_ASSERT(index < total);
+
+		if (index < base || index >= base + filled) {
+			base = index;
+			filled = dr.read_range(base, CHUNK, buffer.data());
+			DATAREFW_ASSERT(filled > 0);
+		}
+
+		return buffer[index - base];
+	}
+
+	const Dr& dr;
+	std::size_t total;
+	std::size_t base { 0 };
+	std::size_t filled { 0 };
+	std::array<V, CHUNK> buffer;
+};
+
+// Frame counter used by FindDataref's per-frame cache. Only ever touched from
+// the sim thread, like everything else in XPLMDataAccess.
+template <typename Dummy = void>
+struct impl_frame_clock {
+	static std::uint64_t epoch;
+};
+
+template <typename Dummy>
+std::uint64_t impl_frame_clock<Dummy>::epoch = 1;
+
+// Call once per flight loop; cached FindDatarefs re-read XPLM on their next
+// access afterwards.
+inline void
+advance_frame() noexcept {
+	++impl_frame_clock<>::epoch;
+}
+
+DATAREFW_NODISCARD inline std::uint64_t
+frame_epoch() noexcept {
+	return impl_frame_clock<>::epoch;
+}
+
+#if defined(DATAREFW_INSTRUMENT_TIMING) || defined(DATAREFW_INSTRUMENT_CALLBACKS)
+// Timestamps for the instrumentation: the TSC where there is one,
+// steady_clock nanoseconds otherwise.
+inline std::uint64_t
+impl_probe_now() noexcept {
+#ifdef DATAREFW_RDTSC
+	return __rdtsc();
+#else
+	return static_cast<std::uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Nanoseconds per impl_probe_now() tick, measured once against steady_clock
+// when the TSC is in use.
+inline double
+impl_probe_ns_per_tick() {
+#ifdef DATAREFW_RDTSC
+	static const double ns_per_tick = [] {
+		const auto t0 = std::chrono::steady_clock::now();
+		const auto c0 = impl_probe_now();
+		auto t1 = t0;
+		while ((t1 - t0) < std::chrono::milliseconds(5)) {
+			t1 = std::chrono::steady_clock::now();
+		}
+		const auto c1 = impl_probe_now();
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+		return (c1 > c0) ? static_cast<double> (ns) / static_cast<double> (c1 - c0) : 1.0;
+	}();
+	return ns_per_tick;
+#else
+	return 1.0;
+#endif
+}
+#endif
+
+#ifdef DATAREFW_INSTRUMENT
+// XPLM calls made by FindDatarefs, kept per path on the path's record.
+// Sim thread only, like the calls themselves.
+struct impl_call_counters {
+	std::uint64_t lookups { 0 };
+	std::uint64_t gets { 0 };
+	std::uint64_t sets { 0 };
+	std::uint64_t array_reads { 0 };
+	std::uint64_t size_queries { 0 };
+	std::uint64_t ticks { 0 };
+};
+
+// Counts one call and, with DATAREFW_INSTRUMENT_TIMING, adds the time until
+// the end of the full expression it was created in.
+class impl_call_probe {
+public:
+#ifdef DATAREFW_INSTRUMENT_TIMING
+	impl_call_probe(std::uint64_t& counter, std::uint64_t& total) noexcept :
+		ticks(total), start(impl_probe_now()) {
+		++counter;
+	}
+#else
+	impl_call_probe(std::uint64_t& counter, std::uint64_t&) noexcept {
+		++counter;
+	}
+#endif
+
+	impl_call_probe(const impl_call_probe&) = delete;
+	impl_call_probe& operator=(const impl_call_probe&) = delete;
+
+#ifdef DATAREFW_INSTRUMENT_TIMING
+	~impl_call_probe() {
+		ticks += impl_probe_now() - start;
+	}
+private:
+	std::uint64_t& ticks;
+	std::uint64_t start;
+#endif
+};
+
+# define DATAREFW_COUNTED(rec, field, call) \
+	(::datarefw::impl_call_probe((rec)->counters.field, (rec)->counters.ticks), (call))
+#else
+# define DATAREFW_COUNTED(rec, field, call) (call)
+#endif // DATAREFW_INSTRUMENT
+
+// One address per type, to tell types apart at runtime without RTTI.
+template <typename T>
+struct impl_type_key {
+	static const char id;
+};
+
+template <typename T>
+const char impl_type_key<T>::id = 0;
+
+// Frame-cached array or string value of a record, see impl_dataref_record.
+struct impl_record_cache {
+	virtual ~impl_record_cache() = default;
+};
+
+template <typename T>
+struct impl_record_cache_of : impl_record_cache {
+	T value { };
+};
+
+// Process-wide table of resolved datarefs. Every wrapper looking up the same
+// path shares one record, so a path costs one XPLMFindDataRef and one copy of
+// its name no matter how many wrappers use it. Records live for the whole
+// process; paths that weren't found are retried on the next lookup, since
+// plugins can register them later.
+// Everything a read touches comes first, so it stays on one cache line.
+struct impl_dataref_record {
+	XPLMDataRef loc { nullptr };
+	XPLMDataTypeID types { xplmType_Unknown };
+	bool writable { false };
+
+	// This path's entry in the write-behind queue, valid while
+	// pending_generation matches the queue's. Shared by every wrapper on the
+	// path, so they all update one entry.
+	mutable std::uint64_t pending_generation { 0 };
+	mutable std::size_t pending_slot { 0 };
+
+	// The FindDataref frame cache, shared by every cached wrapper on the
+	// path so a set through any of them is seen by all. Valid while
+	// cache_epoch matches the frame clock and cache_type is the reader's
+	// impl_type_key; scalars live in cache_number, arrays and strings in
+	// cache_storage, allocated on first use.
+	mutable std::uint64_t cache_epoch { 0 };
+	mutable const void *cache_type { nullptr };
+	mutable double cache_number { 0.0 };
+	mutable std::unique_ptr<impl_record_cache> cache_storage;
+
+	std::string name;
+
+	// The DatarefProxy read serving this path in the batch proxy_batch,
+	// sim thread only.
+	mutable const void *proxy_leader { nullptr };
+	mutable std::uint64_t proxy_batch { 0 };
+#ifdef DATAREFW_INSTRUMENT
+	mutable impl_call_counters counters;
+#endif
+};
+
+// Leaked on purpose so global wrappers can still use it during static
+// init/teardown.
+inline std::unordered_map<std::string, std::unique_ptr<impl_dataref_record>>&
+impl_dataref_records() {
+	static auto *records =
+		new std::unordered_map<std::string, std::unique_ptr<impl_dataref_record>>;
+	return *records;
+}
+
+// What unresolved wrappers point to, so they never hold a null record.
+inline const impl_dataref_record *
+impl_null_dataref_record() {
+	static const impl_dataref_record *empty = new impl_dataref_record;
+	return empty;
+}
+
+inline const impl_dataref_record *
+intern_dataref(const std::string& dr_str) {
+	DATAREFW_ASSERT(dr_str != "");
+	DATAREFW_ASSERT(dr_str.find(' ') == std::string::npos);
+
+	auto& slot = impl_dataref_records()[dr_str];
+
+	if (!slot) {
+		slot.reset(new impl_dataref_record);
+		slot->name = dr_str;
+	}
+
+	if (slot->loc == nullptr) {
+		slot->loc = DATAREFW_COUNTED(slot, lookups, XPLMFindDataRef(dr_str.c_str()));
+
+		if (slot->loc != nullptr) {
+			slot->types = XPLMGetDataRefTypes(slot->loc);
+			slot->writable = XPLMCanWriteDataRef(slot->loc);
+		}
+	}
+
+	return slot.get();
+}
+
+// Drops every resolved handle (e.g. from XPluginStop). Existing wrappers
+// report not found until their path is looked up again.
+inline void
+reset_dataref_registry() {
+	for (auto& it : impl_dataref_records()) {
+		it.second->loc = nullptr;
+		it.second->types = xplmType_Unknown;
+		it.second->writable = false;
+	}
+}
+
+// XPLM calls made by FindDatarefs on one path, see dataref_call_stats().
+struct DatarefCallStats {
+	std::string path;
+	std::uint64_t lookups;
+	std::uint64_t gets;
+	std::uint64_t sets;
+	std::uint64_t array_reads;
+	std::uint64_t size_queries;
+
+	// Time inside those calls, 0 without DATAREFW_INSTRUMENT_TIMING.
+	std::uint64_t nanoseconds;
+
+	DATAREFW_NODISCARD std::uint64_t
+	calls() const noexcept {
+		return lookups + gets + sets + array_reads + size_queries;
+	}
+};
+
+// Every path that was called at least once since the last
+// reset_dataref_call_stats(), most expensive first: by time when
+// DATAREFW_INSTRUMENT_TIMING is on, by number of calls otherwise. Always
+// empty without DATAREFW_INSTRUMENT.
+DATAREFW_NODISCARD inline std::vector<DatarefCallStats>
+dataref_call_stats() {
+	std::vector<DatarefCallStats> rows;
+#ifdef DATAREFW_INSTRUMENT
+#ifdef DATAREFW_INSTRUMENT_TIMING
+	const double ns_per_tick = impl_probe_ns_per_tick();
+#endif
+	for (const auto& it : impl_dataref_records()) {
+		const auto& c = it.second->counters;
+		DatarefCallStats row { it.first, c.lookups, c.gets, c.sets, c.array_reads,
+			c.size_queries, 0 };
+#ifdef DATAREFW_INSTRUMENT_TIMING
+		row.nanoseconds = static_cast<std::uint64_t> (static_cast<double> (c.ticks) * ns_per_tick);
+#endif
+		if (row.calls() != 0) {
+			rows.push_back(std::move(row));
+		}
+	}
+
+	std::sort(rows.begin(), rows.end(), [](const DatarefCallStats& a, const DatarefCallStats& b) {
+		if (a.nanoseconds != b.nanoseconds) {
+			return a.nanoseconds > b.nanoseconds;
+		}
+		if (a.calls() != b.calls()) {
+			return a.calls() > b.calls();
+		}
+		return a.path < b.path;
+	});
+#endif // DATAREFW_INSTRUMENT
+	return rows;
+}
+
+inline void
+reset_dataref_call_stats() noexcept {
+#ifdef DATAREFW_INSTRUMENT
+	for (auto& it : impl_dataref_records()) {
+		it.second->counters = impl_call_counters {};
+	}
+#endif
+}
+
+// dataref_call_stats() as a text table, at most max_rows rows (0 for all).
+DATAREFW_NODISCARD inline std::string
+format_dataref_call_stats(std::size_t max_rows = 0) {
+#ifdef DATAREFW_INSTRUMENT
+	const auto rows = dataref_call_stats();
+	const std::size_t n = (max_rows == 0) ? rows.size() : std::min(max_rows, rows.size());
+
+	std::string out = "datarefw: XPLM calls by dataref\n";
+	char line[96];
+	std::snprintf(line, sizeof(line), "%10s %10s %10s %10s %10s %12s  %s\n",
+		"lookups", "gets", "sets", "arr_reads", "sizes", "time_us", "path");
+	out += line;
+
+	for (std::size_t i = 0; i < n; ++i) {
+		const auto& r = rows[i];
+		std::snprintf(line, sizeof(line), "%10llu %10llu %10llu %10llu %10llu %12.1f  ",
+			static_cast<unsigned long long> (r.lookups),
+			static_cast<unsigned long long> (r.gets),
+			static_cast<unsigned long long> (r.sets),
+			static_cast<unsigned long long> (r.array_reads),
+			static_cast<unsigned long long> (r.size_queries),
+			static_cast<double> (r.nanoseconds) / 1000.0);
+		out += line;
+		out += r.path;
+		out += '\n';
+	}
+	return out;
+#else
+	DATAREFW_UNUSED(max_rows);
+	return "datarefw: instrumentation is compiled out, define DATAREFW_INSTRUMENT\n";
+#endif
+}
+
+// Writes format_dataref_call_stats() to Log.txt.
+inline void
+dump_dataref_call_stats(std::size_t max_rows = 0) {
+	XPLMDebugString(format_dataref_call_stats(max_rows).c_str());
+}
+
+// Handle slot for a path known at compile time, one per distinct path for
+// the whole program. FindDataref<T, slot> resolves through it instead of
+// keeping or looking up a string of its own.
+struct impl_static_path {
+	const char *name;
+	const impl_dataref_record *record;
+};
+
+constexpr bool
+impl_path_has_space(const char *s) {
+	return (*s != '\0') && ((*s == ' ') || impl_path_has_space(s + 1));
+}
+
+constexpr bool
+impl_path_valid(const char *s) {
+	return (*s != '\0') && !impl_path_has_space(s);
+}
+
+// Matched on the argument rather than compared, since the address of a slot
+// isn't always a constant expression a compiler will compare against null.
+template <impl_static_path *Path>
+struct impl_has_static_path : std::true_type {};
+
+template <>
+struct impl_has_static_path<nullptr> : std::false_type {};
+
+inline const impl_dataref_record *
+impl_resolve_static_path(impl_static_path *path) {
+	if ((path->record == nullptr) || (path->record->loc == nullptr)) {
+		path->record = intern_dataref(path->name);
+	}
+	return path->record;
+}
+
+// Slot behind DATAREFW_PATH. A static member of a template, so every
+// translation unit naming the same tag shares it.
+template <typename Tag>
+struct impl_path_tag {
+	static impl_static_path slot;
+};
+
+template <typename Tag>
+impl_static_path impl_path_tag<Tag>::slot { Tag::c_str(), nullptr };
+
+// Declares a tag type `id` for a compile-time path, usable as
+// FindDataref<T, &id::slot>. Must be used at namespace scope, and in a header
+// when the same path is wanted from several translation units.
+#define DATAREFW_PATH(id, str) \
+	struct id : ::datarefw::impl_path_tag<id> { \
+		static_assert(::datarefw::impl_path_valid(str), \
+			"Dataref path can't be empty or contain spaces"); \
+		static constexpr const char * \
+		c_str() noexcept { \
+			return str; \
+		} \
+	}
+
+#ifdef DATAREFW_HAS_PATH_LITERALS
+template <std::size_t N>
+struct impl_path_literal {
+	char chars[N] {};
+
+	constexpr
+	impl_path_literal(const char (&str)[N]) noexcept {
+		for (std::size_t i = 0; i < N; ++i) {
+			chars[i] = str[i];
+		}
+	}
+};
+
+template <impl_path_literal L>
+struct impl_path_literal_slot {
+	static_assert(impl_path_valid(L.chars),
+		"Dataref path can't be empty or contain spaces");
+	static impl_static_path slot;
+};
+
+template <impl_path_literal L>
+impl_static_path impl_path_literal_slot<L>::slot { L.chars, nullptr };
+
+// "sim/..."_dr, the slot for that path as a FindDataref template argument.
+template <impl_path_literal L>
+constexpr impl_static_path *
+operator""_dr() noexcept {
+	return &impl_path_literal_slot<L>::slot;
+}
+#endif // DATAREFW_HAS_PATH_LITERALS
+
+// Scalar writes queued by write-behind FindDatarefs until flush_writes(), one
+// per dataref. Entries hold the handle rather than the wrapper, so a wrapper
+// can be copied or destroyed with a write still pending.
+struct impl_pending_write {
+	XPLMDataRef loc;
+	XPLMDataTypeID type;
+	double value;
+#ifdef DATAREFW_INSTRUMENT
+	const impl_dataref_record *record;
+#endif
+};
+
+template <typename Dummy = void>
+struct impl_write_queue {
+	static std::vector<impl_pending_write> pending;
+	static std::uint64_t generation;
+};
+
+template <typename Dummy>
+std::vector<impl_pending_write> impl_write_queue<Dummy>::pending;
+
+template <typename Dummy>
+std::uint64_t impl_write_queue<Dummy>::generation = 1;
+
+// Call once at the end of the flight loop: one XPLM set per dataref written
+// through write-behind FindDatarefs, with the last value any of them wrote,
+// in the order the datarefs were first written.
+inline void
+flush_writes() noexcept {
+	for (const auto& w : impl_write_queue<>::pending) {
+		// Dropped by a direct set made after it was queued.
+		if (w.loc == nullptr) {
+			continue;
+		}
+		switch (w.type) {
+			case xplmType_Int:
+				DATAREFW_COUNTED(w.record, sets, XPLMSetDatai(w.loc, static_cast<int> (w.value)));
+				break;
+			case xplmType_Float:
+				DATAREFW_COUNTED(w.record, sets, XPLMSetDataf(w.loc, static_cast<float> (w.value)));
+				break;
+			default:
+				DATAREFW_COUNTED(w.record, sets, XPLMSetDatad(w.loc, w.value));
+				break;
+		}
+	}
+
+	// clear() keeps the capacity, so steady state doesn't allocate.
+	impl_write_queue<>::pending.clear();
+	++impl_write_queue<>::generation;
+}
+
+template <typename T, typename F>
+struct impl_proxy_read;
+
+template <typename T, typename F>
+struct impl_proxy_write;
+
 template <typename T>
+struct impl_frame_group_of;
+
+struct impl_frame_access;
+
+// Path is null for wrappers found at runtime through find_dataref(), or a
+// compile-time slot ("..."_dr / DATAREFW_PATH) the wrapper resolves itself
+// through on construction.
+template <typename T, impl_static_path *Path = nullptr>
 class FindDataref {
 public:
 	using value_type = T;
 
-	FindDataref() = default;
+	FindDataref() {
+		impl_find_static_path(impl_has_static_path<Path>());
+	}
 
 	FindDataref(const std::string& dr_str) {
 		find_dataref(dr_str);
 	}
 
-	FindDataref(const FindDataref<T>& dr_o) = default;
-	FindDataref(FindDataref<T>&& dr_o) = default;
-	FindDataref<T>& operator=(const FindDataref<T>& dr_o) = default;
-	FindDataref<T>& operator=(FindDataref<T>&& dr_o) = default;
+	FindDataref(const FindDataref& dr_o) = default;
+	FindDataref(FindDataref&& dr_o) = default;
+	FindDataref& operator=(const FindDataref& dr_o) = default;
+	FindDataref& operator=(FindDataref&& dr_o) = default;
 
 	void
 	find_dataref(const std::string& dr_str) {
-		dataref_name = dr_str;
-		impl_find_dataref();
+		static_assert(!impl_has_static_path<Path>::value,
+			"Path is fixed at compile time");
+		impl_attach(intern_dataref(dr_str));
 	}
 
 	template <typename U = T, typename val_type = typename U::value_type,
@@ -146,7 +918,10 @@ public:
 	template <typename U = T,
 		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD std::size_t
-	size() const noexcept {
+	size() const {
+		if (frame_cached) {
+			return impl_cache_refresh().size();
+		}
 		return impl_get_array_size();
 	}
 
@@ -154,10 +929,128 @@ public:
 		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD auto
 	at(std::size_t index) -> val_type {
+		if (frame_cached) {
+			const auto& arr = impl_cache_refresh();
+			DATAREFW_ASSERT(index < arr.size());
+			return arr[index];
+		}
 		DATAREFW_ASSERT(index < impl_get_array_size());
 		return impl_arr_get_val(index);
 	}
 
+	// Copies up to count elements, starting at element offset of the dataref,
+	// into dst and returns how many were copied. Never allocates.
+	template <typename U = T, typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value ||
+			dr_type_is_byte<U>::value, U>::type* = nullptr>
+	std::size_t
+	read_into(val_type *dst, std::size_t count, std::size_t offset = 0) const {
+		DATAREFW_ASSERT(dst != nullptr);
+
+		if (frame_cached) {
+			const auto& cur = impl_cache_refresh();
+			if (offset >= cur.size()) {
+				return 0;
+			}
+			const auto n = std::min(count, cur.size() - offset);
+			std::memcpy(dst, cur.data() + offset, n * sizeof(val_type));
+			return n;
+		}
+
+		impl_verify_dataref_found();
+		const int n = impl_xplm_read(dst, static_cast<int> (offset),
+			static_cast<int> (count));
+		return (n > 0) ? static_cast<std::size_t> (n) : 0;
+	}
+
+	// Reads the whole string into dst, reusing its capacity. Returns the new
+	// length.
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	std::size_t
+	read_into(std::string& dst) const {
+		if (frame_cached) {
+			dst.assign(impl_cache_refresh());
+		} else {
+			impl_read_string(dst);
+		}
+		return dst.size();
+	}
+
+	// read_into() with the arguments in XPLM order.
+	template <typename U = T, typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value ||
+			dr_type_is_byte<U>::value, U>::type* = nullptr>
+	std::size_t
+	read_range(std::size_t offset, std::size_t count, val_type *dst) const {
+		return read_into(dst, count, offset);
+	}
+
+	// Writes count elements from src starting at element offset, in one call.
+	template <typename U = T, typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value ||
+			dr_type_is_byte<U>::value, U>::type* = nullptr>
+	void
+	write_range(std::size_t offset, std::size_t count, const val_type *src) {
+		DATAREFW_ASSERT(src != nullptr);
+		impl_verify_dataref_found();
+		impl_xplm_write(src, static_cast<int> (offset), static_cast<int> (count));
+		record->cache_epoch = 0;
+	}
+
+	// Iterates the whole array, CHUNK elements per XPLM call:
+	//
+	//	for (float v : dr.chunked()) { ... }
+	template <std::size_t CHUNK = 64, typename U = T,
+		typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD ChunkedReader<FindDataref, val_type, CHUNK>
+	chunked() const {
+		static_assert(CHUNK > 0, "Chunk size can't be zero.");
+		return ChunkedReader<FindDataref, val_type, CHUNK>(*this, size());
+	}
+
+	// Opt-in: the first read in a frame (see advance_frame()) goes to XPLM,
+	// later reads in the same frame return that value. The cache is kept on
+	// the path's shared record, so every cached wrapper on it sees the same
+	// value; writes through any wrapper update it for writable scalars and
+	// drop it otherwise.
+	void
+	cache_per_frame(bool enable = true) noexcept {
+		frame_cached = enable;
+	}
+
+	DATAREFW_NODISCARD bool
+	cached_per_frame() const noexcept {
+		return frame_cached;
+	}
+
+	// Opt-in for scalars: writes (including ++, += and friends) only update a
+	// local shadow value that reads see, and flush_writes() sends the last
+	// one to XPLM.
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	write_behind(bool enable = true) noexcept {
+		write_behind_enabled = enable;
+	}
+
+	// True while a write to this dataref, through any write-behind wrapper,
+	// is waiting for flush_writes().
+	DATAREFW_NODISCARD bool
+	write_pending() const noexcept {
+		return (record->pending_generation == impl_write_queue<>::generation) &&
+			(impl_write_queue<>::pending[record->pending_slot].loc == record->loc);
+	}
+
+	// Forces the next cached read of this path, through any wrapper, to go
+	// to XPLM, e.g. after another plugin was told to change the value
+	// mid-frame.
+	void
+	invalidate() noexcept {
+		record->cache_epoch = 0;
+	}
+
 	// Prefix increment
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, int>::value, U>::type* = nullptr>
@@ -264,19 +1157,19 @@ public:
 	}
 
 	friend std::ostream&
-	operator<<(std::ostream& os, const FindDataref<T>& obj) {
+	operator<<(std::ostream& os, const FindDataref& obj) {
 		os << obj.impl_dr_get();
 		return os;
 	}
 
 	DATAREFW_NODISCARD bool
 	found() const noexcept {
-		return dataref_found;
+		return (record->loc != nullptr);
 	}
 
 	DATAREFW_NODISCARD bool
 	writable() const noexcept {
-		return dataref_writable;
+		return record->writable;
 	}
 
 	operator T() const {
@@ -285,53 +1178,199 @@ public:
 
 	explicit
 	operator bool() const noexcept {
-		return dataref_found;
+		return (record->loc != nullptr);
 	}
 
-	DATAREFW_NODISCARD auto
+	DATAREFW_NODISCARD std::string
 	path() const {
-		DATAREFW_ASSERT(dataref_found);
-		return dataref_name;
+		DATAREFW_ASSERT(found());
+		return record->name;
 	}
 
 	~FindDataref() = default;
 private:
-	// Int value
-	template <typename U = T,
-		typename std::enable_if<std::is_same<U, int>::value, U>::type* = nullptr>
+	// Whether the record holds this frame's value as T.
+	DATAREFW_NODISCARD bool
+	impl_cache_current() const noexcept {
+		return (record->cache_epoch == impl_frame_clock<>::epoch) &&
+			(record->cache_type == &impl_type_key<T>::id);
+	}
+
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD T
+	impl_cache_refresh() const {
+		if (!impl_cache_current()) {
+			impl_cache_store(impl_xplm_get());
+		}
+		return static_cast<T> (record->cache_number);
+	}
+
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	impl_cache_store(const T value) const noexcept {
+		record->cache_number = value;
+		record->cache_type = &impl_type_key<T>::id;
+		record->cache_epoch = impl_frame_clock<>::epoch;
+	}
+
+	// Only reallocates when wrappers of two array types share a path.
+	template <typename U = T,
+		typename std::enable_if<!dr_type_is_number<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD const T&
+	impl_cache_refresh() const {
+		if (!impl_cache_current()) {
+			if (record->cache_type != &impl_type_key<T>::id || !record->cache_storage) {
+				record->cache_storage.reset(new impl_record_cache_of<T>);
+				record->cache_type = &impl_type_key<T>::id;
+			}
+			static_cast<impl_record_cache_of<T> *> (record->cache_storage.get())->value =
+				impl_xplm_get();
+			record->cache_epoch = impl_frame_clock<>::epoch;
+		}
+		return static_cast<const impl_record_cache_of<T> *> (record->cache_storage.get())->value;
+	}
+
+	DATAREFW_NODISCARD T
+	impl_dr_get() const {
+		if (write_pending()) {
+			return impl_pending_value();
+		}
+		if (frame_cached) {
+			return impl_cache_refresh();
+		}
+		return impl_xplm_get();
+	}
+
+	void
+	impl_dr_set(const T& value) {
+		if (write_behind_enabled) {
+			impl_queue_write(value);
+			return;
+		}
+
+		// A direct set supersedes whatever another wrapper queued, so the
+		// flush can't overwrite it with an older value.
+		if (write_pending()) {
+			impl_write_queue<>::pending[record->pending_slot].loc = nullptr;
+		}
+		impl_xplm_set(value);
+		impl_cache_after_set(value);
+	}
+
+	// Keeps the record's frame cache right for every wrapper on the path,
+	// cached or not. Non-writable datarefs silently ignore the set, and
+	// arrays/strings aren't worth a copy just to save the next read.
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	impl_cache_after_set(const T value) const noexcept {
+		if (record->writable) {
+			impl_cache_store(value);
+		} else {
+			record->cache_epoch = 0;
+		}
+	}
+
+	template <typename U = T,
+		typename std::enable_if<!dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	impl_cache_after_set(const T&) const noexcept {
+		record->cache_epoch = 0;
+	}
+
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	impl_queue_write(const T& value) {
+		impl_verify_dataref_found();
+
+		// The sim would ignore the set, so reads mustn't see it either.
+		if (!record->writable) {
+			return;
+		}
+		auto& pending = impl_write_queue<>::pending;
+
+		// Reuse the dataref's entry while it's still queued.
+		if (!write_pending()) {
+			const XPLMDataTypeID type =
+				std::is_same<U, int>::value ? xplmType_Int :
+				std::is_same<U, float>::value ? xplmType_Float : xplmType_Double;
+			impl_pending_write w {};
+			w.loc = record->loc;
+			w.type = type;
+#ifdef DATAREFW_INSTRUMENT
+			w.record = record;
+#endif
+			pending.push_back(w);
+			record->pending_slot = pending.size() - 1;
+			record->pending_generation = impl_write_queue<>::generation;
+		}
+
+		// Reads check the queue before the frame cache.
+		pending[record->pending_slot].value = value;
+	}
+
+	template <typename U = T,
+		typename std::enable_if<!dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	impl_queue_write(const T&) {
+		DATAREFW_ASSERT(!write_behind_enabled);
+	}
+
+	// What flush_writes() will send, as T. Only scalars ever have one.
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD T
+	impl_pending_value() const noexcept {
+		return static_cast<T> (impl_write_queue<>::pending[record->pending_slot].value);
+	}
+
+	// Never queued, so never pending.
+	template <typename U = T,
+		typename std::enable_if<!dr_type_is_number<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD T
+	impl_pending_value() const {
+		return impl_xplm_get();
+	}
+
+	// Int value
+	template <typename U = T,
+		typename std::enable_if<std::is_same<U, int>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD int
-	impl_dr_get() const noexcept {
+	impl_xplm_get() const noexcept {
 		impl_verify_dataref_found();
-		return XPLMGetDatai(dataref_loc);
+		return DATAREFW_COUNTED(record, gets, XPLMGetDatai(record->loc));
 	}
 
 	// Float value
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, float>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD float
-	impl_dr_get() const noexcept {
+	impl_xplm_get() const noexcept {
 		impl_verify_dataref_found();
-		return XPLMGetDataf(dataref_loc);
+		return DATAREFW_COUNTED(record, gets, XPLMGetDataf(record->loc));
 	}
 
 	// Double value
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, double>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD double
-	impl_dr_get() const noexcept {
+	impl_xplm_get() const noexcept {
 		impl_verify_dataref_found();
-		return XPLMGetDatad(dataref_loc);
+		return DATAREFW_COUNTED(record, gets, XPLMGetDatad(record->loc));
 	}
 
 	// Int array vector
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, DrIntArr>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD DrIntArr
-	impl_dr_get() const {
+	impl_xplm_get() const {
 		impl_verify_dataref_found();
 		auto sz = impl_get_array_size();
 		DrIntArr arr_val(sz);
-		XPLMGetDatavi(dataref_loc, arr_val.data(), 0, sz);
+		DATAREFW_COUNTED(record, array_reads, XPLMGetDatavi(record->loc, arr_val.data(), 0, sz));
 		return arr_val;
 	}
 
@@ -342,7 +1381,7 @@ private:
 	impl_arr_get_val(const std::size_t index) const noexcept {
 		impl_verify_dataref_found();
 		DrIntArr::value_type arr_val {};
-		XPLMGetDatavi(dataref_loc, &arr_val, index, 1);
+		DATAREFW_COUNTED(record, array_reads, XPLMGetDatavi(record->loc, &arr_val, index, 1));
 		return arr_val;
 	}
 
@@ -350,11 +1389,11 @@ private:
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, DrFloatArr>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD DrFloatArr
-	impl_dr_get() const {
+	impl_xplm_get() const {
 		impl_verify_dataref_found();
 		auto sz = impl_get_array_size();
 		DrFloatArr arr_val(sz);
-		XPLMGetDatavf(dataref_loc, arr_val.data(), 0, sz);
+		DATAREFW_COUNTED(record, array_reads, XPLMGetDatavf(record->loc, arr_val.data(), 0, sz));
 		return arr_val;
 	}
 
@@ -362,24 +1401,70 @@ private:
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, std::string>::value, U>::type* = nullptr>
 	DATAREFW_NODISCARD std::string
-	impl_dr_get() const {
+	impl_xplm_get() const {
 		impl_verify_dataref_found();
 
-		auto sz = impl_get_array_size();
+		std::string ret_str;
+		impl_read_string(ret_str);
+		return ret_str;
+	}
+
+	// Reuses dst's capacity, so this only allocates when the string grows.
+	void
+	impl_read_string(std::string& dst) const {
+		impl_verify_dataref_found();
 
-		if (sz == 0) { return {}; }
+		const int sz = DATAREFW_COUNTED(record, size_queries,
+			XPLMGetDatab(record->loc, nullptr, 0, 0));
 
-		char *dr_val = new char[sz + 1];
+		if (sz <= 0) {
+			dst.clear();
+			return;
+		}
 
-		XPLMGetDatab(dataref_loc, dr_val, 0, sz);
+		dst.resize(sz);
+		const int n = DATAREFW_COUNTED(record, array_reads,
+			XPLMGetDatab(record->loc, &dst[0], 0, sz));
+		dst.resize(n > 0 ? n : 0);
 
-		if (dr_val[sz] != '\0') {
-			dr_val[sz] = '\0';
+		// Byte datarefs holding c-strings end at the first terminator.
+		const auto nul = dst.find('\0');
+		if (nul != std::string::npos) {
+			dst.resize(nul);
 		}
+	}
 
-		std::string ret_str(dr_val);
-		delete[] dr_val;
-		return ret_str;
+	int
+	impl_xplm_read(int *dst, int offset, int max) const noexcept {
+		return DATAREFW_COUNTED(record, array_reads, XPLMGetDatavi(record->loc, dst, offset, max));
+	}
+
+	int
+	impl_xplm_read(float *dst, int offset, int max) const noexcept {
+		return DATAREFW_COUNTED(record, array_reads, XPLMGetDatavf(record->loc, dst, offset, max));
+	}
+
+	int
+	impl_xplm_read(char *dst, int offset, int max) const noexcept {
+		return DATAREFW_COUNTED(record, array_reads, XPLMGetDatab(record->loc, dst, offset, max));
+	}
+
+	void
+	impl_xplm_write(const int *src, int offset, int count) const noexcept {
+		DATAREFW_COUNTED(record, sets,
+			XPLMSetDatavi(record->loc, const_cast<int *> (src), offset, count));
+	}
+
+	void
+	impl_xplm_write(const float *src, int offset, int count) const noexcept {
+		DATAREFW_COUNTED(record, sets,
+			XPLMSetDatavf(record->loc, const_cast<float *> (src), offset, count));
+	}
+
+	void
+	impl_xplm_write(const char *src, int offset, int count) const noexcept {
+		DATAREFW_COUNTED(record, sets,
+			XPLMSetDatab(record->loc, const_cast<char *> (src), offset, count));
 	}
 
 	// Float array Element
@@ -389,7 +1474,7 @@ private:
 	impl_arr_get_val(const std::size_t index) const {
 		impl_verify_dataref_found();
 		DrFloatArr::value_type arr_val {};
-		XPLMGetDatavf(dataref_loc, &arr_val, index, 1);
+		DATAREFW_COUNTED(record, array_reads, XPLMGetDatavf(record->loc, &arr_val, index, 1));
 		return arr_val;
 	}
 
@@ -399,7 +1484,7 @@ private:
 	DATAREFW_NODISCARD std::size_t
 	impl_get_array_size() const noexcept {
 		impl_verify_dataref_found();
-		return XPLMGetDatavi(dataref_loc, nullptr, 0, 0);
+		return DATAREFW_COUNTED(record, size_queries, XPLMGetDatavi(record->loc, nullptr, 0, 0));
 	}
 
 	// Float array size
@@ -408,7 +1493,7 @@ private:
 	DATAREFW_NODISCARD std::size_t
 	impl_get_array_size() const noexcept {
 		impl_verify_dataref_found();
-		return XPLMGetDatavf(dataref_loc, nullptr, 0, 0);
+		return DATAREFW_COUNTED(record, size_queries, XPLMGetDatavf(record->loc, nullptr, 0, 0));
 	}
 
 	// String size
@@ -417,586 +1502,4818 @@ private:
 	DATAREFW_NODISCARD std::size_t
 	impl_get_array_size() const noexcept {
 		impl_verify_dataref_found();
-		return XPLMGetDatab(dataref_loc, nullptr, 0, 0);
+		return DATAREFW_COUNTED(record, size_queries, XPLMGetDatab(record->loc, nullptr, 0, 0));
 	}
 
 	// Int value set
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, int>::value, U>::type* = nullptr>
 	void
-	impl_dr_set(const int value) const noexcept {
+	impl_xplm_set(const int value) const noexcept {
 		impl_verify_dataref_found();
-		XPLMSetDatai(dataref_loc, value);
+		DATAREFW_COUNTED(record, sets, XPLMSetDatai(record->loc, value));
 	}
 
 	// Float value set
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, float>::value, U>::type* = nullptr>
 	void
-	impl_dr_set(const float value) const noexcept {
+	impl_xplm_set(const float value) const noexcept {
 		impl_verify_dataref_found();
-		XPLMSetDataf(dataref_loc, value);
+		DATAREFW_COUNTED(record, sets, XPLMSetDataf(record->loc, value));
 	}
 
 	// Double value set
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, double>::value, U>::type* = nullptr>
 	void
-	impl_dr_set(const float value) const noexcept {
+	impl_xplm_set(const double value) const noexcept {
 		impl_verify_dataref_found();
-		XPLMSetDatad(dataref_loc, value);
+		DATAREFW_COUNTED(record, sets, XPLMSetDatad(record->loc, value));
 	}
 
 	// Int array vector set
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, DrIntArr>::value, U>::type* = nullptr>
 	void
-	impl_dr_set(const DrIntArr& value) const {
+	impl_xplm_set(const DrIntArr& value) const {
 		impl_verify_dataref_found();
-		XPLMSetDatavi(dataref_loc, const_cast<int*> (value.data()), 0, value.size());
+		DATAREFW_COUNTED(record, sets,
+			XPLMSetDatavi(record->loc, const_cast<int*> (value.data()), 0, value.size()));
 	}
 
 	// Float array vector set
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, DrFloatArr>::value, U>::type* = nullptr>
 	void
-	impl_dr_set(const DrFloatArr& value) const {
+	impl_xplm_set(const DrFloatArr& value) const {
 		impl_verify_dataref_found();
-		XPLMSetDatavf(dataref_loc, const_cast<float*> (value.data()), 0, value.size());
+		DATAREFW_COUNTED(record, sets,
+			XPLMSetDatavf(record->loc, const_cast<float*> (value.data()), 0, value.size()));
 	}
 
 	// String value set
 	template <typename U = T,
 		typename std::enable_if<std::is_same<U, std::string>::value, U>::type* = nullptr>
 	void
-	impl_dr_set(const std::string& value) const {
+	impl_xplm_set(const std::string& value) const {
 		impl_verify_dataref_found();
-		XPLMSetDatab(dataref_loc, const_cast<char *> (value.data()), 0, value.length());
+		DATAREFW_COUNTED(record, sets,
+			XPLMSetDatab(record->loc, const_cast<char *> (value.data()), 0, value.length()));
 	}
 
 	void
-	impl_find_dataref() {
-		DATAREFW_ASSERT(dataref_name != "");
-		DATAREFW_ASSERT(dataref_name.find(' ') == std::string::npos);
-		verify_types<T>();
+	impl_find_static_path(std::true_type) {
+		impl_attach(impl_resolve_static_path(Path));
+	}
 
-		dataref_loc = XPLMFindDataRef(dataref_name.c_str());
+	void
+	impl_find_static_path(std::false_type) noexcept {}
 
-		if (dataref_loc == nullptr) {
-			return;			
-		}
+	void
+	impl_attach(const impl_dataref_record *rec) {
+		verify_types<T>();
+		static_assert(!dr_type_is_fixed_string<T>::value,
+			"FixedString is only supported by CreateDataref");
 
-		dataref_types = XPLMGetDataRefTypes(dataref_loc);
+		record = rec;
+		verified_loc = nullptr;
 
-		// Verify our template-provided type is correct (don't want anything weird
-		// trying to access/set data).
-		switch (dataref_types) {
-			case xplmType_Int:
-				DATAREFW_ASSERT((std::is_same<int, T>::value));
-				break;
-			case xplmType_Float:
-				DATAREFW_ASSERT((std::is_same<float, T>::value));
-				break;
-			case xplmType_Double:
-				DATAREFW_ASSERT((std::is_same<double, T>::value));
-				break;
-			case (xplmType_Int | xplmType_Float | xplmType_Double):
-				DATAREFW_ASSERT(dr_type_is_number<T>::value);
-				break;
-			case xplmType_IntArray:
-				DATAREFW_ASSERT((std::is_same<DrIntArr, T>::value));
-				break;
-			case xplmType_FloatArray:
-				DATAREFW_ASSERT((std::is_same<DrFloatArr, T>::value));
-				break;
-			case xplmType_Data:
-				DATAREFW_ASSERT((std::is_same<std::string, T>::value));
-				break;
-			case xplmType_Unknown:
-				DATAREFW_ASSERT(dataref_types != xplmType_Unknown);
-				break;
-		};
+		if (record->loc != nullptr) {
+			impl_verify_handle();
+		}
+	}
 
-		dataref_writable = XPLMCanWriteDataRef(dataref_loc);
-		dataref_found = true;
+	// The record can resolve long after attaching (another plugin registers
+	// the path later, or it's looked up again after reset_dataref_registry()),
+	// so the type is checked on the first use of each new handle.
+	void
+	impl_verify_handle() const noexcept {
+		verify_dataref_type<T>(record->types);
+		verified_loc = record->loc;
 	}
 
 	void
 	impl_verify_dataref_found() const noexcept {
-		DATAREFW_ASSERT(dataref_loc != nullptr);
+		DATAREFW_ASSERT(record->loc != nullptr);
+		if (verified_loc != record->loc) {
+			impl_verify_handle();
+		}
 	}
 
 	void
 	impl_verify_dataref_writable() const noexcept {
-		DATAREFW_ASSERT(dataref_writable != false);
+		DATAREFW_ASSERT(record->writable != false);
 	}
 
-	std::string dataref_name;
-	XPLMDataRef dataref_loc { nullptr };
-	XPLMDataTypeID dataref_types { xplmType_Unknown };
-	bool dataref_writable { false };
-	bool dataref_found { false };
+	// The proxy and the scheduler attach straight to the records they have
+	// already interned.
+	template <typename U, typename F>
+	friend struct impl_proxy_read;
+
+	template <typename U, typename F>
+	friend struct impl_proxy_write;
+
+	template <typename U>
+	friend struct impl_frame_group_of;
+
+	friend struct impl_frame_access;
+
+	const impl_dataref_record *record { impl_null_dataref_record() };
+	mutable XPLMDataRef verified_loc { nullptr };
+	bool frame_cached { false };
+	bool write_behind_enabled { false };
 };
 
-	
-template <typename T, std::size_t ARRAY_SIZE = 0>
-class CreateDataref {
+// Fixed-size int/float arrays whose length is known up front (engines,
+// failure slots, ...). The dataref's size is checked once in find_dataref(),
+// after that every access is a single XPLM call bounded by N.
+template <typename V, std::size_t N, impl_static_path *Path>
+class FindDataref<std::array<V, N>, Path> {
 public:
-	using value_type = T;
+	using value_type = std::array<V, N>;
 	using size_type = std::size_t;
 
-	CreateDataref() = default;
+	static_assert(std::is_same<int, V>::value || std::is_same<float, V>::value,
+		"Unsupported Type");
+	static_assert(N > 0, "Array size can't be zero.");
 
-	CreateDataref(const std::string& pdr_path, bool pis_writable = false) {
-		create_dataref(pdr_path, pis_writable);
+	FindDataref() {
+		impl_find_static_path(impl_has_static_path<Path>());
+	}
+
+	FindDataref(const std::string& dr_str) {
+		find_dataref(dr_str);
 	}
 
 	void
-	create_dataref(const std::string& pdr_path, bool pis_writable = false) {
-		dataref_name = pdr_path;
-		dataref_writable = pis_writable;
-		impl_create_dataref();
+	find_dataref(const std::string& dr_str) {
+		static_assert(!impl_has_static_path<Path>::value,
+			"Path is fixed at compile time");
+		impl_attach(intern_dataref(dr_str));
 	}
 
-	CreateDataref(const CreateDataref<T, ARRAY_SIZE>& dr_o) = delete;
-	CreateDataref(CreateDataref<T, ARRAY_SIZE>&& dr_o) noexcept
-        : dataref_loc(std::exchange(dr_o.dataref_loc, nullptr)) {}
-	CreateDataref<T, ARRAY_SIZE>& operator=(const CreateDataref<T, ARRAY_SIZE>& dr_o) = delete;
-	CreateDataref<T, ARRAY_SIZE>& operator=(CreateDataref<T, ARRAY_SIZE>&& dr_o) noexcept {
-        std::swap(dataref_loc, dr_o.dataref_loc);
-        return *this;
-    }
+	static constexpr size_type
+	size() noexcept {
+		return N;
+	}
 
-	template <typename U = T, typename val_type = typename U::value_type,
-		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	DATAREFW_NODISCARD auto
-	operator[](const std::size_t index) -> val_type& {
+	DATAREFW_NODISCARD V
+	operator[](const size_type index) const noexcept {
 		return at(index);
 	}
 
-	template <typename U = T,
-		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	DATAREFW_NODISCARD size_type
-	size() const noexcept {
-		return dataref_storage.size();
+	DATAREFW_NODISCARD V
+	at(size_type index) const noexcept {
+		DATAREFW_ASSERT(index < N);
+		impl_verify_dataref_found();
+		V val {};
+		DATAREFW_COUNTED(record, array_reads, impl_xplm_read(&val, static_cast<int> (index), 1));
+		return val;
 	}
 
-	template <typename U = T,
-		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	DATAREFW_NODISCARD size_type
-	max_size() const noexcept {
-		return dataref_storage_max_size;
+	void
+	set(size_type index, V value) noexcept {
+		DATAREFW_ASSERT(index < N);
+		impl_verify_dataref_found();
+		DATAREFW_COUNTED(record, sets, impl_xplm_write(&value, static_cast<int> (index), 1));
 	}
 
-	template <typename U = T, typename val_type = typename U::value_type,
-		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	DATAREFW_NODISCARD auto
-	at(size_type index) -> val_type& {
-		DATAREFW_ASSERT(index < ARRAY_SIZE);
-		return dataref_storage[index];
+	// Whole array in one call, no allocation. Iterate this rather than
+	// calling at() in a loop.
+	DATAREFW_NODISCARD value_type
+	get() const noexcept {
+		impl_verify_dataref_found();
+		value_type arr_val {};
+		DATAREFW_COUNTED(record, array_reads,
+			impl_xplm_read(arr_val.data(), 0, static_cast<int> (N)));
+		return arr_val;
 	}
 
-	// Prefix increment
-	T&
-	operator++() noexcept {
-		dataref_storage++;
-		return dataref_storage;
-	}
+	std::size_t
+	read_into(V *dst, std::size_t count, std::size_t offset = 0) const noexcept {
+		DATAREFW_ASSERT(dst != nullptr);
+		impl_verify_dataref_found();
 
-	// Postfix increment
-	T
-	operator++(int) noexcept {
-		return operator++();
+		if (offset >= N) {
+			return 0;
+		}
+
+		const auto n = std::min(count, N - offset);
+		DATAREFW_COUNTED(record, array_reads,
+			impl_xplm_read(dst, static_cast<int> (offset), static_cast<int> (n)));
+		return n;
 	}
 
-	// Prefix decrement
-	T&
-	operator--() noexcept {
-		dataref_storage--;
-		return dataref_storage;
+	std::size_t
+	read_range(std::size_t offset, std::size_t count, V *dst) const noexcept {
+		return read_into(dst, count, offset);
 	}
 
-	// Postfix decrement
-	T
-	operator--(int) noexcept {
-		return operator--();
+	void
+	write_range(std::size_t offset, std::size_t count, const V *src) noexcept {
+		DATAREFW_ASSERT(src != nullptr);
+		DATAREFW_ASSERT(offset + count <= N);
+		impl_verify_dataref_found();
+		DATAREFW_COUNTED(record, sets,
+			impl_xplm_write(src, static_cast<int> (offset), static_cast<int> (count)));
 	}
 
 	// Assignment operator
-	T
-	operator=(const T& value) {
-		dataref_storage = value;
-		return dataref_storage;
-	}
-	
-	// Compound assignment +=
-	T&
-	operator+=(const T& value) {
-		dataref_storage += value;
-		return dataref_storage;
+	value_type
+	operator=(const value_type& value) noexcept {
+		impl_verify_dataref_found();
+		DATAREFW_COUNTED(record, sets, impl_xplm_write(value.data(), 0, static_cast<int> (N)));
+		return value;
 	}
 
-	// Compound assignment -=
-	T&
-	operator-=(const T& value) {
-		dataref_storage -= value;
-		return dataref_storage;
+	operator value_type() const noexcept {
+		return get();
 	}
 
-	// Compound assignment *=
-	T&
-	operator*=(const T& value) {
-		dataref_storage *= value;
-		return dataref_storage;
+	DATAREFW_NODISCARD bool
+	found() const noexcept {
+		return (record->loc != nullptr);
 	}
 
-	// Compound assignment /=
-	T&
-	operator/=(const T& value) {
-		dataref_storage /= value;
-		return dataref_storage;
+	DATAREFW_NODISCARD bool
+	writable() const noexcept {
+		return record->writable;
 	}
 
-	bool
-	operator==(const T& rhs) {
-		return (dataref_storage == rhs);
+	explicit
+	operator bool() const noexcept {
+		return (record->loc != nullptr);
 	}
 
-	bool
-	operator!=(const T& rhs) {
-		return (dataref_storage != rhs);
+	DATAREFW_NODISCARD std::string
+	path() const {
+		DATAREFW_ASSERT(found());
+		return record->name;
 	}
+private:
+	using impl_vector_type = std::vector<V>;
 
-	bool
-	operator<(const T& rhs) {
-		return (dataref_storage < rhs);
+	int
+	impl_xplm_read(int *dst, int offset, int max) const noexcept {
+		return XPLMGetDatavi(record->loc, dst, offset, max);
 	}
 
-	bool
-	operator>(const T& rhs) {
-		return (dataref_storage > rhs);
+	int
+	impl_xplm_read(float *dst, int offset, int max) const noexcept {
+		return XPLMGetDatavf(record->loc, dst, offset, max);
 	}
 
-	bool
-	operator<=(const T& rhs) {
-		return (dataref_storage <= rhs);
+	void
+	impl_xplm_write(const int *src, int offset, int count) const noexcept {
+		XPLMSetDatavi(record->loc, const_cast<int *> (src), offset, count);
 	}
 
-	bool
-	operator>=(const T& rhs) {
-		return (dataref_storage >= rhs);
+	void
+	impl_xplm_write(const float *src, int offset, int count) const noexcept {
+		XPLMSetDatavf(record->loc, const_cast<float *> (src), offset, count);
 	}
 
-	friend std::ostream&
-	operator<<(std::ostream& os, const CreateDataref<T, ARRAY_SIZE>& obj) {
-		os << obj.dataref_storage;
-		return os;
+	void
+	impl_find_static_path(std::true_type) {
+		impl_attach(impl_resolve_static_path(Path));
 	}
 
-	operator T() const noexcept {
-		return dataref_storage;
-	}
+	void
+	impl_find_static_path(std::false_type) noexcept {}
+
+	void
+	impl_attach(const impl_dataref_record *rec) {
+		record = rec;
+		verified_loc = nullptr;
+
+		if (record->loc != nullptr) {
+			impl_verify_handle();
+		}
+	}
+
+	// Once per handle, like FindDataref<T>::impl_verify_handle().
+	void
+	impl_verify_handle() const noexcept {
+		verify_dataref_type<impl_vector_type>(record->types);
+
+		// The only size query this wrapper ever makes.
+		const int sz = DATAREFW_COUNTED(record, size_queries,
+			impl_xplm_read(static_cast<V *> (nullptr), 0, 0));
+		DATAREFW_ASSERT(sz >= static_cast<int> (N));
+		verified_loc = record->loc;
+	}
+
+	void
+	impl_verify_dataref_found() const noexcept {
+		DATAREFW_ASSERT(record->loc != nullptr);
+		if (verified_loc != record->loc) {
+			impl_verify_handle();
+		}
+	}
+
+	const impl_dataref_record *record { impl_null_dataref_record() };
+	mutable XPLMDataRef verified_loc { nullptr };
+};
+
+// Many scalar datarefs resolved once and read together. Values land in one
+// contiguous array per type, indexed by what add<T>() returned:
+//
+//	DatarefGroup grp;
+//	const auto ias = grp.add<float>("sim/flightmodel/position/indicated_airspeed");
+//	grp.refresh();				// once per frame
+//	float v = grp.get<float>(ias);		// or iterate grp.floats()
+//
+// Datarefs that can't be found read as zero.
+class DatarefGroup {
+public:
+	using size_type = std::size_t;
+
+	DatarefGroup() = default;
+
+	template <typename T>
+	size_type
+	add(const std::string& dr_str) {
+		static_assert(dr_type_is_number<T>::value,
+			"DatarefGroup only holds int, float and double");
+		auto& col = impl_column(static_cast<T *> (nullptr));
+		col.records.push_back(intern_dataref(dr_str));
+		col.verified.push_back(nullptr);
+		col.values.push_back(T {});
+		impl_verify(col, col.values.size() - 1);
+		return col.values.size() - 1;
+	}
+
+	// Reads every member with one XPLM call each. Members go through the
+	// shared records, so they follow reset_dataref_registry() and paths that
+	// resolve later; the type is checked once per new handle.
+	void
+	refresh() noexcept {
+		impl_refresh(int_col, XPLMGetDatai);
+		impl_refresh(float_col, XPLMGetDataf);
+		impl_refresh(double_col, XPLMGetDatad);
+	}
+
+	template <typename T>
+	DATAREFW_NODISCARD T
+	get(size_type index) const {
+		const auto& col = impl_column(static_cast<T *> (nullptr));
+		DATAREFW_ASSERT(index < col.values.size());
+		return col.values[index];
+	}
+
+	template <typename T>
+	DATAREFW_NODISCARD bool
+	found(size_type index) const {
+		const auto& col = impl_column(static_cast<T *> (nullptr));
+		DATAREFW_ASSERT(index < col.records.size());
+		return (col.records[index]->loc != nullptr);
+	}
+
+	template <typename T>
+	DATAREFW_NODISCARD std::string
+	path(size_type index) const {
+		const auto& col = impl_column(static_cast<T *> (nullptr));
+		DATAREFW_ASSERT(index < col.records.size());
+		return col.records[index]->name;
+	}
+
+	DATAREFW_NODISCARD const std::vector<int>&
+	ints() const noexcept {
+		return int_col.values;
+	}
+
+	DATAREFW_NODISCARD const std::vector<float>&
+	floats() const noexcept {
+		return float_col.values;
+	}
+
+	DATAREFW_NODISCARD const std::vector<double>&
+	doubles() const noexcept {
+		return double_col.values;
+	}
+
+	DATAREFW_NODISCARD size_type
+	size() const noexcept {
+		return int_col.values.size() + float_col.values.size() + double_col.values.size();
+	}
+private:
+	template <typename T>
+	struct impl_group_column {
+		std::vector<const impl_dataref_record *> records;
+		std::vector<XPLMDataRef> verified;	// handle whose type was last checked
+		std::vector<T> values;
+	};
+
+	template <typename T>
+	static void
+	impl_verify(impl_group_column<T>& col, size_type i) noexcept {
+		const auto rec = col.records[i];
+		if (rec->loc != nullptr && rec->loc != col.verified[i]) {
+			verify_dataref_type<T>(rec->types);
+			col.verified[i] = rec->loc;
+		}
+	}
+
+	template <typename T, typename R>
+	static void
+	impl_refresh(impl_group_column<T>& col, R (*get)(XPLMDataRef)) noexcept {
+		for (size_type i = 0; i < col.values.size(); ++i) {
+			const auto loc = col.records[i]->loc;
+			if (loc == nullptr) {
+				continue;
+			}
+			if (loc != col.verified[i]) {
+				impl_verify(col, i);
+			}
+			col.values[i] = get(loc);
+		}
+	}
+
+	impl_group_column<int>&
+	impl_column(int *) noexcept {
+		return int_col;
+	}
+
+	const impl_group_column<int>&
+	impl_column(int *) const noexcept {
+		return int_col;
+	}
+
+	impl_group_column<float>&
+	impl_column(float *) noexcept {
+		return float_col;
+	}
+
+	const impl_group_column<float>&
+	impl_column(float *) const noexcept {
+		return float_col;
+	}
+
+	impl_group_column<double>&
+	impl_column(double *) noexcept {
+		return double_col;
+	}
+
+	const impl_group_column<double>&
+	impl_column(double *) const noexcept {
+		return double_col;
+	}
+
+	impl_group_column<int> int_col;
+	impl_group_column<float> float_col;
+	impl_group_column<double> double_col;
+};
+
+// Copies n elements between a CreateDataref's storage and an XPLM caller's
+// buffer. A single memcpy when both sides have the same type, a converting
+// copy otherwise (an int array read as floats or the other way round),
+// vectorized where SSE2/AVX are available.
+template <typename D, typename S>
+inline void
+impl_copy_elements(D *dst, const S *src, std::size_t n) noexcept {
+	for (std::size_t i = 0; i < n; ++i) {
+		dst[i] = static_cast<D> (src[i]);
+	}
+}
+
+template <typename E>
+inline void
+impl_copy_elements(E *dst, const E *src, std::size_t n) noexcept {
+	if (n > 0) {
+		std::memcpy(dst, src, n * sizeof(E));
+	}
+}
+
+// int -> float, rounded to nearest like static_cast.
+inline void
+impl_copy_elements(float *dst, const int *src, std::size_t n) noexcept {
+	std::size_t i = 0;
+#ifdef DATAREFW_AVX
+	for (; i + 8 <= n; i += 8) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (src + i));
+		_mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+	}
+#endif
+#ifdef DATAREFW_SSE2
+	for (; i + 4 <= n; i += 4) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *> (src + i));
+		_mm_storeu_ps(dst + i, _mm_cvtepi32_ps(v));
+	}
+#endif
+	for (; i < n; ++i) {
+		dst[i] = static_cast<float> (src[i]);
+	}
+}
+
+// float -> int, truncated like static_cast.
+inline void
+impl_copy_elements(int *dst, const float *src, std::size_t n) noexcept {
+	std::size_t i = 0;
+#ifdef DATAREFW_AVX
+	for (; i + 8 <= n; i += 8) {
+		const __m256i v = _mm256_cvttps_epi32(_mm256_loadu_ps(src + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (dst + i), v);
+	}
+#endif
+#ifdef DATAREFW_SSE2
+	for (; i + 4 <= n; i += 4) {
+		const __m128i v = _mm_cvttps_epi32(_mm_loadu_ps(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (dst + i), v);
+	}
+#endif
+	for (; i < n; ++i) {
+		dst[i] = static_cast<int> (src[i]);
+	}
+}
+
+// One foreign write to an observed CreateDataref (see CreateDataref::observe()).
+// Scalars carry the new value; arrays and byte datarefs the range that was
+// written, in elements/bytes, to be read back from the dataref itself.
+struct DatarefChange {
+	std::uint32_t id;		// as given to observe()
+	XPLMDataTypeID type;
+	std::int32_t offset;
+	std::int32_t count;		// 0 for scalars
+	double value;			// scalars only
+	std::uint64_t timestamp;	// steady_clock, in ns
+};
+
+// Bounded lock-free queue of DatarefChanges, filled by the write callbacks on
+// the sim thread and drained by any number of other threads (per-slot
+// sequence numbers, Vyukov style). A full queue never blocks the sim: the
+// change is dropped and counted instead.
+class ChangeQueue {
+public:
+	using size_type = std::size_t;
+
+	// capacity must be a power of two.
+	explicit ChangeQueue(size_type capacity) :
+		cells(new impl_cell[capacity]), mask(capacity - 1) {
+		DATAREFW_ASSERT(capacity >= 2 && (capacity & mask) == 0);
+
+		for (size_type i = 0; i < capacity; ++i) {
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	ChangeQueue(const ChangeQueue& o) = delete;
+	ChangeQueue& operator=(const ChangeQueue& o) = delete;
+
+	bool
+	try_push(const DatarefChange& change) noexcept {
+		size_type pos = tail.load(std::memory_order_relaxed);
+
+		for (;;) {
+			impl_cell& cell = cells[pos & mask];
+			const size_type seq = cell.seq.load(std::memory_order_acquire);
+
+			if (seq == pos) {
+				if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.change = change;
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (seq < pos) {
+				dropped_count.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			} else {
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool
+	try_pop(DatarefChange& out) noexcept {
+		size_type pos = head.load(std::memory_order_relaxed);
+
+		for (;;) {
+			impl_cell& cell = cells[pos & mask];
+			const size_type seq = cell.seq.load(std::memory_order_acquire);
+
+			if (seq == pos + 1) {
+				if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					out = cell.change;
+					cell.seq.store(pos + mask + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (seq < pos + 1) {
+				return false;
+			} else {
+				pos = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Pops everything queued right now into fn, returns how many.
+	template <typename F>
+	size_type
+	drain(F&& fn) {
+		size_type n = 0;
+		DatarefChange change;
+		while (try_pop(change)) {
+			fn(change);
+			++n;
+		}
+		return n;
+	}
+
+	DATAREFW_NODISCARD size_type
+	capacity() const noexcept {
+		return mask + 1;
+	}
+
+	// Changes lost to a full queue so far.
+	DATAREFW_NODISCARD std::uint64_t
+	dropped() const noexcept {
+		return dropped_count.load(std::memory_order_relaxed);
+	}
+private:
+	struct impl_cell {
+		std::atomic<size_type> seq;
+		DatarefChange change;
+	};
+
+	std::unique_ptr<impl_cell[]> cells;
+	const size_type mask;
+
+	// A cache line each. Padded rather than alignas(64), like FrameRing, so
+	// queues can be allocated with plain new.
+	char impl_pad0[64];
+	std::atomic<size_type> tail { 0 };
+	char impl_pad1[64];
+	std::atomic<size_type> head { 0 };
+	char impl_pad2[64];
+	std::atomic<std::uint64_t> dropped_count { 0 };
+	char impl_pad3[64];
+};
+
+// Bounded lock-free ring of fixed-size records, for exactly one producer and
+// one consumer thread. A push is one memcpy into a preallocated slot; a full
+// ring drops the record and counts it rather than waiting.
+class FrameRing {
+public:
+	using size_type = std::size_t;
+
+	// capacity (records) must be a power of two. Slots are 8-byte aligned.
+	FrameRing(size_type capacity, size_type stride) :
+		slot_words((stride + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t)),
+		record_size(stride), mask(capacity - 1),
+		slots(new std::uint64_t[capacity * slot_words]()) {
+		DATAREFW_ASSERT(capacity >= 2 && (capacity & mask) == 0);
+		DATAREFW_ASSERT(stride > 0);
+	}
+
+	FrameRing(const FrameRing& o) = delete;
+	FrameRing& operator=(const FrameRing& o) = delete;
+
+	// Producer only.
+	bool
+	try_push(const void *record) noexcept {
+		const size_type h = head.load(std::memory_order_relaxed);
+
+		if (h - cached_tail > mask) {
+			cached_tail = tail.load(std::memory_order_acquire);
+			if (h - cached_tail > mask) {
+				dropped_count.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		}
+
+		std::memcpy(impl_slot(h), record, record_size);
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only: the oldest record, or null when empty. It stays in the
+	// ring until pop().
+	DATAREFW_NODISCARD const unsigned char *
+	front() noexcept {
+		const size_type t = tail.load(std::memory_order_relaxed);
+
+		if (t == cached_head) {
+			cached_head = head.load(std::memory_order_acquire);
+			if (t == cached_head) {
+				return nullptr;
+			}
+		}
+
+		return reinterpret_cast<const unsigned char *> (impl_slot(t));
+	}
+
+	// Consumer only, after front() returned a record.
+	void
+	pop() noexcept {
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	DATAREFW_NODISCARD size_type
+	capacity() const noexcept {
+		return mask + 1;
+	}
+
+	DATAREFW_NODISCARD size_type
+	stride() const noexcept {
+		return record_size;
+	}
+
+	// Records lost to a full ring so far.
+	DATAREFW_NODISCARD std::uint64_t
+	dropped() const noexcept {
+		return dropped_count.load(std::memory_order_relaxed);
+	}
+private:
+	std::uint64_t *
+	impl_slot(size_type pos) const noexcept {
+		return &slots[(pos & mask) * slot_words];
+	}
+
+	const size_type slot_words;
+	const size_type record_size;
+	const size_type mask;
+	std::unique_ptr<std::uint64_t[]> slots;
+
+	// Each side's index next to its cached copy of the other's. Padded
+	// rather than alignas(64), so rings can be allocated with plain new.
+	char impl_pad0[64];
+	std::atomic<size_type> head { 0 };
+	size_type cached_tail { 0 };
+	std::atomic<std::uint64_t> dropped_count { 0 };
+	char impl_pad1[64];
+	std::atomic<size_type> tail { 0 };
+	size_type cached_head { 0 };
+	char impl_pad2[64];
+};
+
+// Start of every frame a DatarefRecorder produces.
+struct RecordedFrame {
+	std::uint64_t sequence;	// sample() calls before this one; gaps are drops
+	std::int64_t time_us;	// XPLMGetElapsedTime(), in microseconds
+};
+
+// Where one recorded dataref sits inside a frame.
+struct RecorderColumn {
+	std::string path;
+	XPLMDataTypeID type;	// xplmType_Int, _Float or _Double
+	std::size_t offset;	// bytes from the start of the frame
+};
+
+// A RecordedFrame followed by every double, then every float, then every
+// int, each in the order they were added, padded to 8 bytes.
+struct RecorderLayout {
+	std::vector<RecorderColumn> columns;
+	std::size_t stride;
+};
+
+// Receives a DatarefRecorder's frames on its background thread.
+class RecorderSink {
+public:
+	virtual ~RecorderSink() = default;
+
+	virtual void
+	begin(const RecorderLayout& layout) = 0;
+
+	// frame is layout.stride bytes, valid only during the call.
+	virtual void
+	write(const unsigned char *frame) = 0;
+
+	virtual void
+	end() = 0;
+};
+
+// Frames written back to back, exactly as recorded.
+class RawFrameFileSink : public RecorderSink {
+public:
+	explicit RawFrameFileSink(const std::string& file_path) :
+		file(std::fopen(file_path.c_str(), "wb")) {}
+
+	RawFrameFileSink(const RawFrameFileSink& o) = delete;
+	RawFrameFileSink& operator=(const RawFrameFileSink& o) = delete;
+
+	DATAREFW_NODISCARD bool
+	is_open() const noexcept {
+		return (file != nullptr);
+	}
+
+	void
+	begin(const RecorderLayout& layout) override {
+		stride = layout.stride;
+	}
+
+	void
+	write(const unsigned char *frame) override {
+		if (file != nullptr) {
+			std::fwrite(frame, 1, stride, file);
+		}
+	}
+
+	void
+	end() override {
+		if (file != nullptr) {
+			std::fflush(file);
+		}
+	}
+
+	~RawFrameFileSink() override {
+		if (file != nullptr) {
+			std::fclose(file);
+		}
+	}
+private:
+	std::FILE *file;
+	std::size_t stride { 0 };
+};
+
+// Records a set of scalar datarefs every frame without doing the I/O on the
+// sim thread:
+//
+//	DatarefRecorder recorder;
+//	const auto ias = recorder.add<float>("sim/flightmodel/position/indicated_airspeed");
+//	...
+//	recorder.start(sink);	// spawns the writer thread
+//
+//	// every flight loop
+//	recorder.sample();
+//
+// sample() reads every dataref into a staging frame and pushes it onto a
+// FrameRing with one memcpy; a background thread hands frames to the sink.
+// If the sink falls behind, whole frames are dropped and counted, and the
+// sim thread never waits.
+class DatarefRecorder {
+public:
+	using size_type = std::size_t;
+
+	// ring_frames must be a power of two.
+	explicit DatarefRecorder(size_type ring_frames = 1024) : ring_capacity(ring_frames) {}
+
+	DatarefRecorder(const DatarefRecorder& o) = delete;
+	DatarefRecorder& operator=(const DatarefRecorder& o) = delete;
+
+	// Like DatarefGroup::add(), and only before start().
+	template <typename T>
+	size_type
+	add(const std::string& dr_str) {
+		static_assert(dr_type_is_number<T>::value,
+			"DatarefRecorder only records int, float and double");
+		DATAREFW_ASSERT(!ring);
+
+		auto& col = impl_column(static_cast<T *> (nullptr));
+		col.records.push_back(intern_dataref(dr_str));
+		col.verified.push_back(nullptr);
+		impl_verify<T>(col, col.records.size() - 1);
+		return col.records.size() - 1;
+	}
+
+	// Fixes the frame layout and starts the thread feeding sink, which has
+	// to outlive stop(). Paths still missing are looked up once more here;
+	// after that they are sampled as soon as anything finds them.
+	void
+	start(RecorderSink& sink) {
+		DATAREFW_ASSERT(!ring);
+		impl_resolve_column<double>(double_col);
+		impl_resolve_column<float>(float_col);
+		impl_resolve_column<int>(int_col);
+		impl_build_layout();
+
+		staging.reset(new std::uint64_t[frame_layout.stride / sizeof(std::uint64_t)]());
+		ring.reset(new FrameRing(ring_capacity, frame_layout.stride));
+		running.store(true, std::memory_order_relaxed);
+		writer = std::thread(&DatarefRecorder::impl_drain, this, std::ref(sink));
+	}
+
+	// Call once per frame on the sim thread.
+	void
+	sample() noexcept {
+		DATAREFW_ASSERT(ring);
+		auto base = reinterpret_cast<unsigned char *> (staging.get());
+
+		RecordedFrame header { sequence++,
+			static_cast<std::int64_t> (XPLMGetElapsedTime() * 1e6 + 0.5) };
+		std::memcpy(base, &header, sizeof(header));
+
+		impl_read_column<double>(double_col, base + double_offset);
+		impl_read_column<float>(float_col, base + float_offset);
+		impl_read_column<int>(int_col, base + int_offset);
+
+		ring->try_push(base);
+	}
+
+	// Lets the thread write out what is queued, then joins it.
+	void
+	stop() {
+		if (!writer.joinable()) {
+			return;
+		}
+		running.store(false, std::memory_order_release);
+		writer.join();
+	}
+
+	// The value from the last sample().
+	template <typename T>
+	DATAREFW_NODISCARD T
+	get(size_type index) const {
+		const auto& col = impl_column(static_cast<T *> (nullptr));
+		DATAREFW_ASSERT(ring && index < col.records.size());
+		T value;
+		std::memcpy(&value, reinterpret_cast<const unsigned char *> (staging.get()) +
+			impl_column_offset(static_cast<T *> (nullptr)) + index * sizeof(T), sizeof(T));
+		return value;
+	}
+
+	// Valid once started.
+	DATAREFW_NODISCARD const RecorderLayout&
+	layout() const noexcept {
+		return frame_layout;
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	sampled() const noexcept {
+		return sequence;
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	dropped() const noexcept {
+		return ring ? ring->dropped() : 0;
+	}
+
+	~DatarefRecorder() {
+		stop();
+	}
+private:
+	// Records, like DatarefGroup's, so paths registered after add() and
+	// handles looked up again after reset_dataref_registry() are sampled.
+	struct impl_recorder_column {
+		std::vector<const impl_dataref_record *> records;
+		std::vector<XPLMDataRef> verified;	// handle whose type was last checked
+	};
+
+	template <typename T>
+	static void
+	impl_verify(impl_recorder_column& col, size_type i) noexcept {
+		const auto rec = col.records[i];
+		if (rec->loc != nullptr && rec->loc != col.verified[i]) {
+			verify_dataref_type<T>(rec->types);
+			col.verified[i] = rec->loc;
+		}
+	}
+
+	template <typename T>
+	static void
+	impl_resolve_column(impl_recorder_column& col) {
+		for (size_type i = 0; i < col.records.size(); ++i) {
+			if (col.records[i]->loc == nullptr) {
+				intern_dataref(col.records[i]->name);
+			}
+			impl_verify<T>(col, i);
+		}
+	}
+
+	void
+	impl_build_layout() {
+		double_offset = sizeof(RecordedFrame);
+		float_offset = double_offset + double_col.records.size() * sizeof(double);
+		int_offset = float_offset + float_col.records.size() * sizeof(float);
+		const size_type end = int_offset + int_col.records.size() * sizeof(int);
+
+		frame_layout.stride = (end + sizeof(std::uint64_t) - 1) & ~(sizeof(std::uint64_t) - 1);
+		frame_layout.columns.clear();
+		impl_add_columns(double_col, xplmType_Double, double_offset, sizeof(double));
+		impl_add_columns(float_col, xplmType_Float, float_offset, sizeof(float));
+		impl_add_columns(int_col, xplmType_Int, int_offset, sizeof(int));
+	}
+
+	void
+	impl_add_columns(const impl_recorder_column& col, XPLMDataTypeID type,
+		size_type offset, size_type width) {
+		for (size_type i = 0; i < col.records.size(); ++i) {
+			frame_layout.columns.push_back(RecorderColumn { col.records[i]->name, type,
+				offset + i * width });
+		}
+	}
+
+	static int
+	impl_xplm_get(XPLMDataRef ref, int *) noexcept {
+		return XPLMGetDatai(ref);
+	}
+
+	static float
+	impl_xplm_get(XPLMDataRef ref, float *) noexcept {
+		return XPLMGetDataf(ref);
+	}
+
+	static double
+	impl_xplm_get(XPLMDataRef ref, double *) noexcept {
+		return XPLMGetDatad(ref);
+	}
+
+	// Missing datarefs record as zero.
+	template <typename T>
+	static void
+	impl_read_column(impl_recorder_column& col, unsigned char *dst) noexcept {
+		const size_type n = col.records.size();
+		for (size_type i = 0; i < n; ++i) {
+			const auto loc = col.records[i]->loc;
+			T value {};
+			if (loc != nullptr) {
+				if (loc != col.verified[i]) {
+					impl_verify<T>(col, i);
+				}
+				value = impl_xplm_get(loc, static_cast<T *> (nullptr));
+			}
+			std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+		}
+	}
+
+	void
+	impl_drain(RecorderSink& sink) {
+		sink.begin(frame_layout);
+
+		for (;;) {
+			// Checked before draining, so frames pushed before stop() still go out.
+			const bool more = running.load(std::memory_order_acquire);
+
+			while (const unsigned char *frame = ring->front()) {
+				sink.write(frame);
+				ring->pop();
+			}
+
+			if (!more) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		sink.end();
+	}
+
+	impl_recorder_column&
+	impl_column(int *) noexcept {
+		return int_col;
+	}
+
+	const impl_recorder_column&
+	impl_column(int *) const noexcept {
+		return int_col;
+	}
+
+	impl_recorder_column&
+	impl_column(float *) noexcept {
+		return float_col;
+	}
+
+	const impl_recorder_column&
+	impl_column(float *) const noexcept {
+		return float_col;
+	}
+
+	impl_recorder_column&
+	impl_column(double *) noexcept {
+		return double_col;
+	}
+
+	const impl_recorder_column&
+	impl_column(double *) const noexcept {
+		return double_col;
+	}
+
+	size_type
+	impl_column_offset(int *) const noexcept {
+		return int_offset;
+	}
+
+	size_type
+	impl_column_offset(float *) const noexcept {
+		return float_offset;
+	}
+
+	size_type
+	impl_column_offset(double *) const noexcept {
+		return double_offset;
+	}
+
+	impl_recorder_column int_col;
+	impl_recorder_column float_col;
+	impl_recorder_column double_col;
+	size_type int_offset { 0 };
+	size_type float_offset { 0 };
+	size_type double_offset { 0 };
+	RecorderLayout frame_layout { {}, 0 };
+
+	const size_type ring_capacity;
+	std::unique_ptr<std::uint64_t[]> staging;
+	std::unique_ptr<FrameRing> ring;
+	std::uint64_t sequence { 0 };
+	std::atomic<bool> running { false };
+	std::thread writer;
+};
+
+DATAREFW_NODISCARD inline unsigned
+impl_leading_zeros(std::uint64_t v) noexcept {
+#if (defined(__GNUC__) || defined(__clang__))
+	return (v == 0) ? 64 : static_cast<unsigned> (__builtin_clzll(v));
+#else
+	unsigned n = 0;
+	for (std::uint64_t bit = std::uint64_t(1) << 63; bit != 0 && (v & bit) == 0; bit >>= 1) {
+		++n;
+	}
+	return n;
+#endif
+}
+
+DATAREFW_NODISCARD inline unsigned
+impl_trailing_zeros(std::uint64_t v) noexcept {
+#if (defined(__GNUC__) || defined(__clang__))
+	return (v == 0) ? 64 : static_cast<unsigned> (__builtin_ctzll(v));
+#else
+	unsigned n = 0;
+	for (std::uint64_t bit = 1; bit != 0 && (v & bit) == 0; bit <<= 1) {
+		++n;
+	}
+	return n;
+#endif
+}
+
+// Log-bucketed histogram of durations (or any other unsigned value),
+// HdrHistogram style: values below 8 are exact, larger ones land in one of
+// 8 linear sub-buckets per power of two, so a percentile is never more than
+// 12.5% off. Fixed size, so recording never allocates; values of 2^40 and
+// up are counted as 2^40 - 1.
+class LatencyHistogram {
+public:
+	static constexpr unsigned sub_bits = 3;
+	static constexpr unsigned max_bits = 40;
+	static constexpr std::size_t bucket_count = (max_bits - sub_bits + 1) << sub_bits;
+
+	void
+	record(std::uint64_t value) noexcept {
+		++counts[impl_bucket_of(value)];
+		++total;
+		sum_values += value;
+		max_value = std::max(max_value, value);
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	count() const noexcept {
+		return total;
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	sum() const noexcept {
+		return sum_values;
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	max() const noexcept {
+		return max_value;
+	}
+
+	// Highest value of the bucket holding the q-th quantile (0 to 1), capped
+	// at max(). 0 when nothing was recorded.
+	DATAREFW_NODISCARD std::uint64_t
+	percentile(double q) const noexcept {
+		if (total == 0) {
+			return 0;
+		}
+
+		const double wanted = std::min(std::max(q, 0.0), 1.0) * static_cast<double> (total);
+		std::uint64_t rank = static_cast<std::uint64_t> (wanted);
+		if (static_cast<double> (rank) < wanted || rank == 0) {
+			++rank;
+		}
+
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < bucket_count; ++i) {
+			seen += counts[i];
+			if (seen >= rank) {
+				return std::min(impl_bucket_high(i), max_value);
+			}
+		}
+		return max_value;
+	}
+
+	void
+	reset() noexcept {
+		counts.fill(0);
+		total = 0;
+		sum_values = 0;
+		max_value = 0;
+	}
+private:
+	static std::size_t
+	impl_bucket_of(std::uint64_t value) noexcept {
+		const std::uint64_t v = std::min(value, (std::uint64_t(1) << max_bits) - 1);
+		if (v < (std::uint64_t(1) << sub_bits)) {
+			return static_cast<std::size_t> (v);
+		}
+
+		const unsigned msb = 63 - impl_leading_zeros(v);
+		const unsigned shift = msb - sub_bits;
+		const std::uint64_t sub = (v >> shift) & ((std::uint64_t(1) << sub_bits) - 1);
+		return (static_cast<std::size_t> (shift + 1) << sub_bits) | static_cast<std::size_t> (sub);
+	}
+
+	static std::uint64_t
+	impl_bucket_high(std::size_t bucket) noexcept {
+		if (bucket < (std::size_t(1) << sub_bits)) {
+			return bucket;
+		}
+
+		const unsigned shift = static_cast<unsigned> (bucket >> sub_bits) - 1;
+		const std::uint64_t low = ((std::uint64_t(1) << sub_bits) |
+			(bucket & ((std::size_t(1) << sub_bits) - 1))) << shift;
+		return low + (std::uint64_t(1) << shift) - 1;
+	}
+
+	std::array<std::uint64_t, bucket_count> counts {};
+	std::uint64_t total { 0 };
+	std::uint64_t sum_values { 0 };
+	std::uint64_t max_value { 0 };
+};
+
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+// Read and write callback timings for one published path, kept for the whole
+// process so a dataref that's recreated keeps adding to the same row.
+struct impl_callback_latency {
+	LatencyHistogram reads;
+	LatencyHistogram writes;
+};
+
+// Leaked on purpose, like impl_dataref_records().
+inline std::unordered_map<std::string, std::unique_ptr<impl_callback_latency>>&
+impl_callback_latencies() {
+	static auto *latencies =
+		new std::unordered_map<std::string, std::unique_ptr<impl_callback_latency>>;
+	return *latencies;
+}
+
+// When the histograms were last reset, for the call rates.
+inline std::chrono::steady_clock::time_point&
+impl_callback_epoch() {
+	static std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return epoch;
+}
+
+inline impl_callback_latency *
+impl_callback_latency_for(const std::string& path) {
+	impl_callback_epoch();
+	auto& slot = impl_callback_latencies()[path];
+	if (!slot) {
+		slot.reset(new impl_callback_latency);
+	}
+	return slot.get();
+}
+
+// Records the time from its construction to the end of the callback.
+class impl_callback_timer {
+public:
+	explicit impl_callback_timer(LatencyHistogram& h) noexcept :
+		hist(h), start(impl_probe_now()) {}
+
+	impl_callback_timer(const impl_callback_timer&) = delete;
+	impl_callback_timer& operator=(const impl_callback_timer&) = delete;
+
+	~impl_callback_timer() {
+		hist.record(impl_probe_now() - start);
+	}
+private:
+	LatencyHistogram& hist;
+	std::uint64_t start;
+};
+
+# define DATAREFW_TIMED_CALLBACK(dr, direction) \
+	const ::datarefw::impl_callback_timer impl_callback_scope((dr)->callback_latency->direction)
+#else
+# define DATAREFW_TIMED_CALLBACK(dr, direction) static_cast<void> (0)
+#endif // DATAREFW_INSTRUMENT_CALLBACKS
+
+// How long other plugins spend in one published dataref's callbacks, see
+// callback_latency_stats(). Times are in nanoseconds, rates in calls per
+// second since the last reset.
+struct CallbackLatencyStats {
+	std::string path;
+	std::uint64_t reads;
+	std::uint64_t writes;
+	double reads_per_second;
+	double writes_per_second;
+	std::uint64_t read_p50;
+	std::uint64_t read_p99;
+	std::uint64_t read_max;
+	std::uint64_t write_p50;
+	std::uint64_t write_p99;
+	std::uint64_t write_max;
+	std::uint64_t total;
+};
+
+// Every CreateDataref, ConcurrentCreateDataref and ComputedDataref path whose
+// callbacks ran since the last reset_callback_latency_stats(), most total
+// time first. Always empty without DATAREFW_INSTRUMENT_CALLBACKS.
+DATAREFW_NODISCARD inline std::vector<CallbackLatencyStats>
+callback_latency_stats() {
+	std::vector<CallbackLatencyStats> rows;
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+	const double ns_per_tick = impl_probe_ns_per_tick();
+	const auto ns = [ns_per_tick](std::uint64_t ticks) {
+		return static_cast<std::uint64_t> (static_cast<double> (ticks) * ns_per_tick);
+	};
+	const double seconds = std::max(1e-9, std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - impl_callback_epoch()).count());
+
+	for (const auto& it : impl_callback_latencies()) {
+		const auto& r = it.second->reads;
+		const auto& w = it.second->writes;
+		if (r.count() == 0 && w.count() == 0) {
+			continue;
+		}
+
+		rows.push_back(CallbackLatencyStats { it.first, r.count(), w.count(),
+			static_cast<double> (r.count()) / seconds,
+			static_cast<double> (w.count()) / seconds,
+			ns(r.percentile(0.5)), ns(r.percentile(0.99)), ns(r.max()),
+			ns(w.percentile(0.5)), ns(w.percentile(0.99)), ns(w.max()),
+			ns(r.sum() + w.sum()) });
+	}
+
+	std::sort(rows.begin(), rows.end(),
+		[](const CallbackLatencyStats& a, const CallbackLatencyStats& b) {
+			if (a.total != b.total) {
+				return a.total > b.total;
+			}
+			return a.path < b.path;
+		});
+#endif // DATAREFW_INSTRUMENT_CALLBACKS
+	return rows;
+}
+
+inline void
+reset_callback_latency_stats() {
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+	for (auto& it : impl_callback_latencies()) {
+		it.second->reads.reset();
+		it.second->writes.reset();
+	}
+	impl_callback_epoch() = std::chrono::steady_clock::now();
+#endif
+}
+
+// callback_latency_stats() as a text table, at most max_rows rows (0 for all).
+DATAREFW_NODISCARD inline std::string
+format_callback_latency_stats(std::size_t max_rows = 0) {
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+	const auto rows = callback_latency_stats();
+	const std::size_t n = (max_rows == 0) ? rows.size() : std::min(max_rows, rows.size());
+
+	std::string out = "datarefw: accessor callback latency (ns)\n";
+	char line[192];
+	std::snprintf(line, sizeof(line),
+		"%10s %10s %8s %8s %8s %10s %10s %8s %8s %8s %12s  %s\n",
+		"reads", "reads/s", "p50", "p99", "max",
+		"writes", "writes/s", "p50", "p99", "max", "total_us", "path");
+	out += line;
+
+	for (std::size_t i = 0; i < n; ++i) {
+		const auto& r = rows[i];
+		std::snprintf(line, sizeof(line),
+			"%10llu %10.1f %8llu %8llu %8llu %10llu %10.1f %8llu %8llu %8llu %12.1f  ",
+			static_cast<unsigned long long> (r.reads), r.reads_per_second,
+			static_cast<unsigned long long> (r.read_p50),
+			static_cast<unsigned long long> (r.read_p99),
+			static_cast<unsigned long long> (r.read_max),
+			static_cast<unsigned long long> (r.writes), r.writes_per_second,
+			static_cast<unsigned long long> (r.write_p50),
+			static_cast<unsigned long long> (r.write_p99),
+			static_cast<unsigned long long> (r.write_max),
+			static_cast<double> (r.total) / 1000.0);
+		out += line;
+		out += r.path;
+		out += '\n';
+	}
+	return out;
+#else
+	DATAREFW_UNUSED(max_rows);
+	return "datarefw: callback timing is compiled out, define DATAREFW_INSTRUMENT_CALLBACKS\n";
+#endif
+}
+
+// Writes format_callback_latency_stats() to Log.txt.
+inline void
+dump_callback_latency_stats(std::size_t max_rows = 0) {
+	XPLMDebugString(format_callback_latency_stats(max_rows).c_str());
+}
+
+// Half-open range of array elements, see CreateDataref::dirty_range().
+struct DirtyRange {
+	std::size_t begin;
+	std::size_t end;
+
+	DATAREFW_NODISCARD bool
+	empty() const noexcept {
+		return (begin >= end);
+	}
+
+	DATAREFW_NODISCARD std::size_t
+	size() const noexcept {
+		return empty() ? 0 : (end - begin);
+	}
+};
+
+// ARRAY_SIZE for a CreateDataref array whose length is only known at runtime,
+// see CreateDataref::resize(). Fixed sizes are stored inline instead.
+constexpr std::size_t dynamic_array_size = static_cast<std::size_t> (-1);
+
+// What a CreateDataref keeps its value in: T itself, except for fixed-size
+// arrays, which live in a std::array inside the object.
+template <typename T, std::size_t ARRAY_SIZE, typename = void>
+struct impl_create_storage {
+	using type = T;
+};
+
+template <typename T, std::size_t ARRAY_SIZE>
+struct impl_create_storage<T, ARRAY_SIZE, typename std::enable_if<dr_type_is_array<T>::value &&
+	(ARRAY_SIZE != dynamic_array_size)>::type> {
+	using type = std::array<typename T::value_type, ARRAY_SIZE>;
+};
+
+template <typename T, std::size_t ARRAY_SIZE = 0>
+class CreateDataref {
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using storage_type = typename impl_create_storage<T, ARRAY_SIZE>::type;
+
+	CreateDataref() = default;
+
+	CreateDataref(const std::string& pdr_path, bool pis_writable = false) {
+		create_dataref(pdr_path, pis_writable);
+	}
+
+	void
+	create_dataref(const std::string& pdr_path, bool pis_writable = false) {
+		dataref_name = pdr_path;
+		dataref_writable = pis_writable;
+		impl_create_dataref();
+	}
+
+	CreateDataref(const CreateDataref<T, ARRAY_SIZE>& dr_o) = delete;
+	CreateDataref(CreateDataref<T, ARRAY_SIZE>&& dr_o) noexcept
+        : dataref_loc(dr_o.dataref_loc) {
+		dr_o.dataref_loc = nullptr;
+	}
+	CreateDataref<T, ARRAY_SIZE>& operator=(const CreateDataref<T, ARRAY_SIZE>& dr_o) = delete;
+	CreateDataref<T, ARRAY_SIZE>& operator=(CreateDataref<T, ARRAY_SIZE>&& dr_o) noexcept {
+        std::swap(dataref_loc, dr_o.dataref_loc);
+        return *this;
+    }
+
+	template <typename U = T, typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD auto
+	operator[](const std::size_t index) -> val_type& {
+		return at(index);
+	}
+
+	template <typename U = T, typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD auto
+	operator[](const std::size_t index) const noexcept -> val_type {
+		return at(index);
+	}
+
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD size_type
+	size() const noexcept {
+		return dataref_storage.size();
+	}
+
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD size_type
+	max_size() const noexcept {
+		return dataref_storage_max_size;
+	}
+
+	// Runtime-sized arrays only (ARRAY_SIZE == dynamic_array_size). Readers
+	// see the new size on their next call.
+	template <typename U = T, std::size_t ARR_SIZE = ARRAY_SIZE,
+		typename std::enable_if<dr_type_is_array<U>::value &&
+		(ARR_SIZE == dynamic_array_size), U>::type* = nullptr>
+	void
+	resize(size_type len) {
+		dataref_storage.resize(len);
+		impl_mark_dirty(0, len);
+	}
+
+	// Advertises the array as xplmType_IntArray | xplmType_FloatArray, so
+	// readers can use whichever type is native to them. The other type is
+	// converted on the fly. Re-registers the dataref if it already exists.
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	void
+	advertise_int_and_float(bool enable = true) {
+		dataref_int_and_float = enable;
+
+		if (dataref_loc != nullptr) {
+			impl_dr_cleanup();
+			impl_create_dataref();
+		}
+	}
+
+	// Reports every write other plugins make to this dataref to queue, tagged
+	// with id. Writes through this wrapper itself aren't reported. Pass
+	// nullptr to stop.
+	void
+	observe(ChangeQueue *queue, std::uint32_t id = 0) noexcept {
+		observer = queue;
+		observer_id = id;
+	}
+
+	// Preallocates string storage so foreign writes up to len bytes don't
+	// allocate (or a runtime-sized array's, so resize() doesn't).
+	template <typename U = T,
+		typename std::enable_if<std::is_same<U, std::string>::value ||
+		(dr_type_is_array<U>::value && (ARRAY_SIZE == dynamic_array_size)), U>::type* = nullptr>
+	void
+	reserve(size_type len) {
+		dataref_storage.reserve(len);
+	}
+
+	template <typename U = T, typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD auto
+	at(size_type index) -> val_type& {
+		DATAREFW_ASSERT(index < dataref_storage.size());
+		// Might be written through, so counted as a write.
+		impl_mark_dirty(index, index + 1);
+		return dataref_storage[index];
+	}
+
+	// Reads an element without counting as a write.
+	template <typename U = T, typename val_type = typename U::value_type,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD auto
+	at(size_type index) const noexcept -> val_type {
+		DATAREFW_ASSERT(index < dataref_storage.size());
+		return dataref_storage[index];
+	}
+
+	// Bumped by every write, ours or another plugin's. Consumers remember the
+	// last version they handled and skip the dataref while it's unchanged.
+	// Taking a reference with the non-const at()/[] counts as a write to that
+	// element; read through a const wrapper to avoid it.
+	DATAREFW_NODISCARD std::uint64_t
+	version() const noexcept {
+		return dataref_version;
+	}
+
+	// Elements written since the last acknowledge(), as [begin, end). Empty
+	// when nothing changed.
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD DirtyRange
+	dirty_range() const noexcept {
+		return DirtyRange { dirty_begin, dirty_end };
+	}
+
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	void
+	acknowledge() noexcept {
+		dirty_begin = 0;
+		dirty_end = 0;
+	}
+
+	// Prefix increment
+	T&
+	operator++() noexcept {
+		dataref_storage++;
+		impl_mark_dirty();
+		return dataref_storage;
+	}
+
+	// Postfix increment
+	T
+	operator++(int) noexcept {
+		return operator++();
+	}
+
+	// Prefix decrement
+	T&
+	operator--() noexcept {
+		dataref_storage--;
+		impl_mark_dirty();
+		return dataref_storage;
+	}
+
+	// Postfix decrement
+	T
+	operator--(int) noexcept {
+		return operator--();
+	}
+
+	// Assignment operator
+	template <typename U = T, typename std::enable_if<std::is_same<U, storage_type>::value, U>::type* = nullptr>
+	T
+	operator=(const T& value) {
+		dataref_storage = value;
+		impl_mark_dirty(0, impl_storage_size());
+		return dataref_storage;
+	}
+
+	// Fixed-size arrays take as many elements as fit, the rest are left alone.
+	// Returns the stored values as T, like the vector-backed overload.
+	template <typename U = T, typename std::enable_if<!std::is_same<U, storage_type>::value, U>::type* = nullptr>
+	T
+	operator=(const T& value) {
+		const auto n = std::min(value.size(), dataref_storage.size());
+		impl_copy_elements(dataref_storage.data(), value.data(), n);
+		impl_mark_dirty(0, n);
+		return impl_storage_value();
+	}
+	
+	// Compound assignment +=
+	T&
+	operator+=(const T& value) {
+		dataref_storage += value;
+		impl_mark_dirty();
+		return dataref_storage;
+	}
+
+	// Compound assignment -=
+	T&
+	operator-=(const T& value) {
+		dataref_storage -= value;
+		impl_mark_dirty();
+		return dataref_storage;
+	}
+
+	// Compound assignment *=
+	T&
+	operator*=(const T& value) {
+		dataref_storage *= value;
+		impl_mark_dirty();
+		return dataref_storage;
+	}
+
+	// Compound assignment /=
+	T&
+	operator/=(const T& value) {
+		dataref_storage /= value;
+		impl_mark_dirty();
+		return dataref_storage;
+	}
+
+	bool
+	operator==(const T& rhs) {
+		return impl_storage_equal(rhs);
+	}
+
+	bool
+	operator!=(const T& rhs) {
+		return !impl_storage_equal(rhs);
+	}
+
+	bool
+	operator<(const T& rhs) {
+		return (dataref_storage < rhs);
+	}
+
+	bool
+	operator>(const T& rhs) {
+		return (dataref_storage > rhs);
+	}
+
+	bool
+	operator<=(const T& rhs) {
+		return (dataref_storage <= rhs);
+	}
+
+	bool
+	operator>=(const T& rhs) {
+		return (dataref_storage >= rhs);
+	}
+
+	friend std::ostream&
+	operator<<(std::ostream& os, const CreateDataref<T, ARRAY_SIZE>& obj) {
+		os << obj.dataref_storage;
+		return os;
+	}
+
+	operator T() const noexcept {
+		return impl_storage_value();
+	}
+
+	explicit
+	operator bool() const noexcept {
+		return (dataref_loc != nullptr);
+	}
+
+	DATAREFW_NODISCARD std::string
+	path() const {
+		return dataref_name;
+	}
+
+	~CreateDataref() {
+		impl_dr_cleanup();
+	}
+private:
+	template <typename U = T, typename std::enable_if<std::is_same<U, storage_type>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD T
+	impl_storage_value() const {
+		return dataref_storage;
+	}
+
+	template <typename U = T, typename std::enable_if<!std::is_same<U, storage_type>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD T
+	impl_storage_value() const {
+		return T(dataref_storage.begin(), dataref_storage.end());
+	}
+
+	template <typename U = T, typename std::enable_if<std::is_same<U, storage_type>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD bool
+	impl_storage_equal(const T& rhs) const {
+		return (dataref_storage == rhs);
+	}
+
+	template <typename U = T, typename std::enable_if<!std::is_same<U, storage_type>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD bool
+	impl_storage_equal(const T& rhs) const {
+		return (rhs.size() == dataref_storage.size()) &&
+			std::equal(rhs.begin(), rhs.end(), dataref_storage.begin());
+	}
+
+	template <typename U, std::size_t ARR_SIZE = 0>
+	static CreateDataref<U, ARR_SIZE> *
+	impl_proc_ref(void *refcon) {
+		DATAREFW_ASSERT(refcon != nullptr);
+		return reinterpret_cast<CreateDataref<U, ARR_SIZE> *> (refcon);
+	}
+
+	static CreateDataref *
+	impl_dr_of(void *refcon) {
+		return impl_proc_ref<T, ARRAY_SIZE>(refcon);
+	}
+
+	// Writes the c-string in values at byte offset, replacing whatever
+	// followed. Only allocates if a std::string grows past its capacity (see
+	// reserve()); FixedString storage is clamped instead.
+	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	static void
+	impl_dr_write_byte(void *refcon, void *values, int offset, int count) {
+		if (values == nullptr || count <= 0) {
+			return;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		auto& storage = impl_proc_ref<T>(refcon)->dataref_storage;
+		const char *cvalues = static_cast<const char *> (values);
+
+		// Ensure proper null-termination on c-strings
+		const void *nul = std::memchr(cvalues, '\0', count);
+		const std::size_t ncount = (nul != nullptr) ?
+			static_cast<std::size_t> (static_cast<const char *> (nul) - cvalues) : count;
+		const std::size_t start = std::min<std::size_t>(offset, storage.size());
+
+		storage.resize(start + ncount);
+		const std::size_t written = storage.size() - start;
+		if (written > 0) {
+			std::memcpy(&storage[start], cvalues, written);
+		}
+
+		impl_proc_ref<T>(refcon)->impl_notify_write(0.0, static_cast<int> (start),
+			static_cast<int> (written));
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD static int
+	impl_dr_read_byte(void *refcon, void *values, int offset, int max) {
+		const auto& storage = impl_proc_ref<T>(refcon)->dataref_storage;
+		const int a_sz = static_cast<int> (storage.size());
+
+		if (values == nullptr) {
+			return a_sz;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz || max <= 0) {
+			return 0;
+		}
+
+		const int upper_limit = std::min(max, a_sz - offset);
+		char *cvalues = static_cast<char *> (values);
+
+		std::memcpy(cvalues, storage.data() + offset, upper_limit);
+
+		// Terminate c-strings for readers that left room for it.
+		if (upper_limit < max) {
+			cvalues[upper_limit] = '\0';
+		}
+
+		return upper_limit;
+	}
+
+	template <typename U, typename V = T, std::size_t ARR_SIZE = ARRAY_SIZE,
+		typename std::enable_if<dr_type_is_array<V>::value, V>::type* = nullptr>
+	static void
+	impl_dr_write_tmplt_arr(void *refcon, U *values, int offset, int count) {
+		const auto odr = impl_proc_ref<T, ARR_SIZE>(refcon);
+		auto& storage = odr->dataref_storage;
+		const int a_sz = static_cast<int> (storage.size());
+
+		if (values == nullptr || count <= 0) {
+			return;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz) {
+			return;
+		}
+
+		// values[0] lands at storage[offset]; anything past the end is dropped.
+		const int upper_limit = std::min(count, a_sz - offset);
+		const U *src = values;
+		impl_copy_elements(storage.data() + offset, src, upper_limit);
+
+		odr->impl_notify_write(0.0, offset, upper_limit);
+	}
+
+	template <typename U, typename V = T, std::size_t ARR_SIZE = ARRAY_SIZE,
+		typename std::enable_if<dr_type_is_array<V>::value, V>::type* = nullptr>
+	DATAREFW_NODISCARD static int
+	impl_dr_read_tmplt_arr(void *refcon, U *values, int offset, int max) {
+		const auto& storage = impl_proc_ref<T, ARR_SIZE>(refcon)->dataref_storage;
+		const int a_sz = static_cast<int> (storage.size());
+
+		if (values == nullptr) {
+			return a_sz;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz || max <= 0) {
+			return 0;
+		}
+
+		const int upper_limit = std::min(max, a_sz - offset);
+		impl_copy_elements(values, storage.data() + offset, upper_limit);
+
+		return upper_limit;
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_i(void *refcon) {
+		const auto odr = impl_dr_of(refcon);
+		DATAREFW_TIMED_CALLBACK(odr, reads);
+		return odr->dataref_storage;
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static void
+	impl_dr_write_i(void *refcon, int val) {
+		const auto odr = impl_dr_of(refcon);
+		DATAREFW_TIMED_CALLBACK(odr, writes);
+		odr->dataref_storage = val;
+		odr->impl_notify_write(static_cast<double> (odr->dataref_storage), 0, 0);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static float
+	impl_dr_read_f(void *refcon) {
+		const auto odr = impl_dr_of(refcon);
+		DATAREFW_TIMED_CALLBACK(odr, reads);
+		return odr->dataref_storage;
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static void
+	impl_dr_write_f(void *refcon, float val) {
+		const auto odr = impl_dr_of(refcon);
+		DATAREFW_TIMED_CALLBACK(odr, writes);
+		odr->dataref_storage = val;
+		odr->impl_notify_write(static_cast<double> (odr->dataref_storage), 0, 0);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static double
+	impl_dr_read_d(void *refcon) {
+		const auto odr = impl_dr_of(refcon);
+		DATAREFW_TIMED_CALLBACK(odr, reads);
+		return odr->dataref_storage;
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static void
+	impl_dr_write_d(void *refcon, double val) {
+		const auto odr = impl_dr_of(refcon);
+		DATAREFW_TIMED_CALLBACK(odr, writes);
+		odr->dataref_storage = val;
+		odr->impl_notify_write(static_cast<double> (odr->dataref_storage), 0, 0);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_vi(void *refcon, int *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_dr_of(refcon), reads);
+		return impl_dr_read_tmplt_arr<int>(refcon, values, offset, max);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	static void
+	impl_dr_write_vi(void *refcon, int *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_dr_of(refcon), writes);
+		impl_dr_write_tmplt_arr<int>(refcon, values, offset, max);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_vf(void *refcon, float *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_dr_of(refcon), reads);
+		return impl_dr_read_tmplt_arr<float>(refcon, values, offset, max);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	static void
+	impl_dr_write_vf(void *refcon, float *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_dr_of(refcon), writes);
+		impl_dr_write_tmplt_arr<float>(refcon, values, offset, max);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_b(void *refcon, void *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_dr_of(refcon), reads);
+		return impl_dr_read_byte(refcon, values, offset, max);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	static void
+	impl_dr_write_b(void *refcon, void *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_dr_of(refcon), writes);
+		impl_dr_write_byte(refcon, values, offset, max);
+	}
+
+	// Array size, 0 for anything else.
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD size_type
+	impl_storage_size() const noexcept {
+		return dataref_storage.size();
+	}
+
+	template <typename U = T, typename std::enable_if<!dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD size_type
+	impl_storage_size() const noexcept {
+		return 0;
+	}
+
+	void
+	impl_mark_dirty(size_type begin = 0, size_type end = 0) noexcept {
+		++dataref_version;
+
+		if (begin >= end) {
+			return;
+		}
+		if (dirty_begin >= dirty_end) {
+			dirty_begin = begin;
+			dirty_end = end;
+		} else {
+			dirty_begin = std::min(dirty_begin, begin);
+			dirty_end = std::max(dirty_end, end);
+		}
+	}
+
+	// Every foreign write ends up here.
+	void
+	impl_notify_write(double value, int offset, int count) noexcept {
+		impl_mark_dirty(static_cast<size_type> (offset),
+			static_cast<size_type> (offset) + static_cast<size_type> (count));
+
+		if (observer == nullptr) {
+			return;
+		}
+
+		const auto now = std::chrono::steady_clock::now().time_since_epoch();
+		DatarefChange change;
+		change.id = observer_id;
+		change.type = dataref_types;
+		change.offset = offset;
+		change.count = count;
+		change.value = value;
+		change.timestamp = static_cast<std::uint64_t> (
+			std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+		observer->try_push(change);
+	}
+
+	void
+	impl_dr_get_datatype() {
+		if (std::is_same<T, int>::value) {
+			dataref_types = xplmType_Int;
+		} else if (std::is_same<T, float>::value) {
+			dataref_types = xplmType_Float;
+		} else if (std::is_same<T, double>::value) {
+			dataref_types = xplmType_Double;
+		} else if (dr_type_is_array<T>::value && dataref_int_and_float) {
+			dataref_types = xplmType_IntArray | xplmType_FloatArray;
+		} else if (std::is_same<T, DrIntArr>::value) {
+			dataref_types = xplmType_IntArray;
+		} else if (std::is_same<T, DrFloatArr>::value) {
+			dataref_types = xplmType_FloatArray;
+		} else if (dr_type_is_byte<T>::value) {
+			dataref_types = xplmType_Data;
+		}
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	register_dataref_accessor() {
+		dataref_loc = XPLMRegisterDataAccessor(
+				dataref_name.c_str(),
+				dataref_types, dataref_writable,
+				impl_dr_read_i, impl_dr_write_i,
+				impl_dr_read_f, impl_dr_write_f,
+				impl_dr_read_d, impl_dr_write_d,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				this, this);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	void
+	register_dataref_accessor() {
+		dataref_loc = XPLMRegisterDataAccessor(
+				dataref_name.c_str(),
+				dataref_types, dataref_writable,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				impl_dr_read_vi, impl_dr_write_vi,
+				impl_dr_read_vf, impl_dr_write_vf,
+				nullptr, nullptr,
+				this, this);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	void
+	register_dataref_accessor() {
+		dataref_loc = XPLMRegisterDataAccessor(
+				dataref_name.c_str(),
+				dataref_types, dataref_writable,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				impl_dr_read_b, impl_dr_write_b,
+				this, this);
+	}
+
+	// I'm sure there's a more *elaborate* way to do the following of which I'm not aware of:
+	template <std::size_t ARR_SIZE = ARRAY_SIZE, typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	constexpr void
+	array_verif() const noexcept {
+		static_assert(ARR_SIZE > 0, "Array size can't be zero (use dynamic_array_size "
+			"for arrays sized at runtime).");
+	}
+
+	template <typename U = T, typename std::enable_if<!dr_type_is_array<U>::value, U>::type* = nullptr>
+	constexpr void
+	array_verif() const noexcept {}
+
+	void
+	impl_create_dataref() {
+		DATAREFW_ASSERT(dataref_name != "");
+		DATAREFW_ASSERT(dataref_name.find(' ') == std::string::npos);
+
+		verify_types<T>();
+		array_verif();
+		impl_dr_get_datatype();
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+		callback_latency = impl_callback_latency_for(dataref_name);
+#endif
+		register_dataref_accessor();
+	}
+
+	void
+	impl_dr_cleanup() {
+		if (dataref_loc) {
+			XPLMUnregisterDataAccessor(dataref_loc);
+			dataref_loc = nullptr;
+		}
+	}
+
+	std::string dataref_name;
+	XPLMDataRef dataref_loc { nullptr };
+	XPLMDataTypeID dataref_types { xplmType_Unknown };
+	bool dataref_writable { false };
+	bool dataref_int_and_float { false };
+	ChangeQueue *observer { nullptr };
+	std::uint32_t observer_id { 0 };
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+	impl_callback_latency *callback_latency { nullptr };
+#endif
+	std::uint64_t dataref_version { 0 };
+	size_type dirty_begin { 0 };
+	size_type dirty_end { 0 };
+	storage_type dataref_storage { };
+	static constexpr size_type dataref_storage_max_size = ARRAY_SIZE;
+};
+
+// One row of a DatarefRegistry table. size is the element count for
+// xplmType_IntArray/FloatArray and the byte capacity for xplmType_Data;
+// scalars ignore it.
+struct DatarefSpec {
+	const char *path;
+	XPLMDataTypeID type;
+	bool writable;
+	std::size_t size;
+};
+
+// Owns a whole table of datarefs, registered in one pass:
+//
+//	static const DatarefSpec table[] = {
+//		{ "myplugin/gear/deploy", xplmType_Int, true, 0 },
+//		{ "myplugin/eng/n1", xplmType_FloatArray, false, 8 },
+//		...
+//	};
+//	DatarefRegistry registry(table);
+//	registry.array<float>(1)[0] = 97.5f;	// indexes are table rows
+//
+// All values live in one block, each next to a small header, and that header
+// is the accessor refcon, so a callback touches a single cache line for
+// scalars. Names are copied into one buffer. unregister_all() (or the
+// destructor) drops every dataref at once, e.g. from XPluginStop.
+class DatarefRegistry {
+public:
+	using size_type = std::size_t;
+
+	DatarefRegistry() = default;
+
+	template <size_type N>
+	explicit DatarefRegistry(const DatarefSpec (&table)[N]) {
+		register_all(table, N);
+	}
+
+	DatarefRegistry(const DatarefRegistry& o) = delete;
+	DatarefRegistry& operator=(const DatarefRegistry& o) = delete;
+
+	void
+	register_all(const DatarefSpec *table, size_type count) {
+		DATAREFW_ASSERT(locs.empty());
+
+		size_type name_bytes = 0;
+		size_type value_words = 0;
+		for (size_type i = 0; i < count; ++i) {
+			DATAREFW_ASSERT(table[i].path != nullptr && *table[i].path != '\0');
+			name_bytes += std::strlen(table[i].path) + 1;
+			value_words += impl_slot_words(table[i]);
+		}
+
+		// Sized up front, nothing below may move once registered. new[]
+		// storage is aligned for any scalar, and every slot is a multiple of
+		// 8 bytes, so every header and payload stays 8-byte aligned.
+		names.reset(new char[name_bytes]);
+		values.reset(new unsigned char[value_words * sizeof(std::uint64_t)]);
+		locs.reserve(count);
+		types.reserve(count);
+		slots.reserve(count);
+		name_offsets.reserve(count);
+
+		size_type name_pos = 0;
+		size_type value_pos = 0;
+		for (size_type i = 0; i < count; ++i) {
+			const auto& spec = table[i];
+			const size_type len = std::strlen(spec.path);
+			DATAREFW_ASSERT(std::memchr(spec.path, ' ', len) == nullptr);
+
+			std::memcpy(&names[name_pos], spec.path, len + 1);
+
+			unsigned char *mem = &values[value_pos * sizeof(std::uint64_t)];
+			const auto slot = new (mem) impl_slot {
+				static_cast<std::uint32_t> (impl_is_scalar(spec.type) ? 1 : spec.size), 0 };
+			impl_construct_payload(spec, mem + sizeof(impl_slot));
+
+			locs.push_back(impl_register(&names[name_pos], spec, slot));
+			types.push_back(spec.type);
+			slots.push_back(slot);
+			name_offsets.push_back(static_cast<std::uint32_t> (name_pos));
+
+			name_pos += len + 1;
+			value_pos += impl_slot_words(spec);
+		}
+	}
+
+	void
+	unregister_all() noexcept {
+		for (auto loc : locs) {
+			if (loc != nullptr) {
+				XPLMUnregisterDataAccessor(loc);
+			}
+		}
+
+		locs.clear();
+		types.clear();
+		slots.clear();
+		name_offsets.clear();
+		names.reset();
+		values.reset();
+	}
+
+	DATAREFW_NODISCARD size_type
+	size() const noexcept {
+		return locs.size();
+	}
+
+	DATAREFW_NODISCARD const char *
+	path(size_type index) const noexcept {
+		DATAREFW_ASSERT(index < size());
+		return &names[name_offsets[index]];
+	}
+
+	DATAREFW_NODISCARD XPLMDataTypeID
+	type(size_type index) const noexcept {
+		DATAREFW_ASSERT(index < size());
+		return types[index];
+	}
+
+	// Linear scan, for setup code; keep the index around afterwards.
+	DATAREFW_NODISCARD size_type
+	index_of(const char *dr_path) const noexcept {
+		for (size_type i = 0; i < size(); ++i) {
+			if (std::strcmp(path(i), dr_path) == 0) {
+				return i;
+			}
+		}
+		return size();
+	}
+
+	// Scalar value, V matching the row's type (int, float or double).
+	template <typename V>
+	DATAREFW_NODISCARD V&
+	value(size_type index) noexcept {
+		impl_check_type<V>(index, false);
+		return *impl_payload<V>(slots[index]);
+	}
+
+	// First element of an int/float array row, array_size() elements long.
+	template <typename V>
+	DATAREFW_NODISCARD V *
+	array(size_type index) noexcept {
+		impl_check_type<V>(index, true);
+		return impl_payload<V>(slots[index]);
+	}
+
+	DATAREFW_NODISCARD size_type
+	array_size(size_type index) const noexcept {
+		DATAREFW_ASSERT(index < size());
+		return slots[index]->size;
+	}
+
+	// xplmType_Data rows: the current bytes, clamped to the row's capacity.
+	void
+	assign(size_type index, const char *str, size_type len) noexcept {
+		DATAREFW_ASSERT(index < size() && types[index] == xplmType_Data);
+		const auto slot = slots[index];
+		slot->length = static_cast<std::uint32_t> (std::min<size_type>(len, slot->size));
+		std::memcpy(impl_payload<char>(slot), str, slot->length);
+	}
+
+	DATAREFW_NODISCARD std::string
+	str(size_type index) const {
+		DATAREFW_ASSERT(index < size() && types[index] == xplmType_Data);
+		const auto slot = slots[index];
+		return std::string(impl_payload<char>(slot), slot->length);
+	}
+
+	~DatarefRegistry() {
+		unregister_all();
+	}
+private:
+	// In front of every value in the block; the accessors' refcon.
+	struct impl_slot {
+		std::uint32_t size;	// elements, or byte capacity for data
+		std::uint32_t length;	// bytes held, data only
+	};
+
+	static_assert(sizeof(impl_slot) == sizeof(std::uint64_t), "Values must stay 8-byte aligned");
+
+	DATAREFW_NODISCARD static bool
+	impl_is_scalar(XPLMDataTypeID type) noexcept {
+		return (type == xplmType_Int) || (type == xplmType_Float) || (type == xplmType_Double);
+	}
+
+	DATAREFW_NODISCARD static size_type
+	impl_slot_words(const DatarefSpec& spec) noexcept {
+		size_type bytes = 0;
+		switch (spec.type) {
+			case xplmType_Int:
+			case xplmType_Float:
+			case xplmType_Double:
+				bytes = sizeof(double);
+				break;
+			case xplmType_IntArray:
+				bytes = spec.size * sizeof(int);
+				break;
+			case xplmType_FloatArray:
+				bytes = spec.size * sizeof(float);
+				break;
+			case xplmType_Data:
+				bytes = spec.size;
+				break;
+			default:
+				DATAREFW_ASSERT(impl_is_scalar(spec.type));
+				break;
+		}
+		DATAREFW_ASSERT(impl_is_scalar(spec.type) || spec.size > 0);
+		return 1 + (bytes + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+	}
+
+	// Starts the lifetime of a row's zeroed values right after its header,
+	// so they're only ever accessed as the type they were created as.
+	template <typename S>
+	static void
+	impl_construct_values(unsigned char *mem, size_type count) noexcept {
+		for (size_type i = 0; i < count; ++i) {
+			new (mem + i * sizeof(S)) S();
+		}
+	}
+
+	static void
+	impl_construct_payload(const DatarefSpec& spec, unsigned char *mem) noexcept {
+		switch (spec.type) {
+			case xplmType_Int:
+				impl_construct_values<int>(mem, 1);
+				break;
+			case xplmType_Float:
+				impl_construct_values<float>(mem, 1);
+				break;
+			case xplmType_Double:
+				impl_construct_values<double>(mem, 1);
+				break;
+			case xplmType_IntArray:
+				impl_construct_values<int>(mem, spec.size);
+				break;
+			case xplmType_FloatArray:
+				impl_construct_values<float>(mem, spec.size);
+				break;
+			default:
+				impl_construct_values<char>(mem, spec.size);
+				break;
+		}
+	}
+
+	template <typename V>
+	static V *
+	impl_payload(impl_slot *slot) noexcept {
+		return impl_launder(reinterpret_cast<V *> (
+			reinterpret_cast<unsigned char *> (slot) + sizeof(impl_slot)));
+	}
+
+	template <typename V>
+	static const V *
+	impl_payload(const impl_slot *slot) noexcept {
+		return impl_launder(reinterpret_cast<const V *> (
+			reinterpret_cast<const unsigned char *> (slot) + sizeof(impl_slot)));
+	}
+
+	template <typename V>
+	static V *
+	impl_launder(V *p) noexcept {
+#ifdef __cpp_lib_launder
+		return std::launder(p);
+#else
+		return p;
+#endif
+	}
+
+	static impl_slot *
+	impl_slot_of(void *refcon) noexcept {
+		DATAREFW_ASSERT(refcon != nullptr);
+		return static_cast<impl_slot *> (refcon);
+	}
+
+	template <typename V>
+	void
+	impl_check_type(size_type index, bool is_array) const noexcept {
+		static_assert(std::is_same<V, int>::value || std::is_same<V, float>::value ||
+			std::is_same<V, double>::value, "Unsupported Type");
+		DATAREFW_ASSERT(index < size());
+
+		XPLMDataTypeID expected = xplmType_Double;
+		if (std::is_same<V, int>::value) {
+			expected = is_array ? xplmType_IntArray : xplmType_Int;
+		} else if (std::is_same<V, float>::value) {
+			expected = is_array ? xplmType_FloatArray : xplmType_Float;
+		}
+		DATAREFW_ASSERT(!(is_array && std::is_same<V, double>::value));
+		DATAREFW_ASSERT(types[index] == expected);
+	}
+
+	template <typename S, typename R>
+	static R
+	impl_dr_read_scalar(void *refcon) {
+		return static_cast<R> (*impl_payload<S>(impl_slot_of(refcon)));
+	}
+
+	template <typename S, typename R>
+	static void
+	impl_dr_write_scalar(void *refcon, R val) {
+		*impl_payload<S>(impl_slot_of(refcon)) = static_cast<S> (val);
+	}
+
+	template <typename S, typename U>
+	static int
+	impl_dr_read_array(void *refcon, U *values, int offset, int max) {
+		const auto slot = impl_slot_of(refcon);
+		const int a_sz = static_cast<int> (slot->size);
+
+		if (values == nullptr) {
+			return a_sz;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz || max <= 0) {
+			return 0;
+		}
+
+		const int upper_limit = std::min(max, a_sz - offset);
+		const S *src = impl_payload<S>(slot) + offset;
+		impl_copy_elements(values, src, upper_limit);
+
+		return upper_limit;
+	}
+
+	template <typename S, typename U>
+	static void
+	impl_dr_write_array(void *refcon, U *values, int offset, int count) {
+		const auto slot = impl_slot_of(refcon);
+		const int a_sz = static_cast<int> (slot->size);
+
+		if (values == nullptr || count <= 0) {
+			return;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz) {
+			return;
+		}
+
+		const int upper_limit = std::min(count, a_sz - offset);
+		const U *src = values;
+		impl_copy_elements(impl_payload<S>(slot) + offset, src, upper_limit);
+	}
+
+	static int
+	impl_dr_read_b(void *refcon, void *values, int offset, int max) {
+		const auto slot = impl_slot_of(refcon);
+		const int a_sz = static_cast<int> (slot->length);
+
+		if (values == nullptr) {
+			return a_sz;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz || max <= 0) {
+			return 0;
+		}
+
+		const int upper_limit = std::min(max, a_sz - offset);
+		char *cvalues = static_cast<char *> (values);
+
+		std::memcpy(cvalues, impl_payload<char>(slot) + offset, upper_limit);
+
+		// Terminate c-strings for readers that left room for it.
+		if (upper_limit < max) {
+			cvalues[upper_limit] = '\0';
+		}
+
+		return upper_limit;
+	}
+
+	// Same semantics as a CreateDataref<FixedString<N>>: the c-string lands
+	// at offset, replacing whatever followed, clamped to the capacity.
+	static void
+	impl_dr_write_b(void *refcon, void *values, int offset, int count) {
+		if (values == nullptr || count <= 0) {
+			return;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		const auto slot = impl_slot_of(refcon);
+		const char *cvalues = static_cast<const char *> (values);
+
+		const void *nul = std::memchr(cvalues, '\0', count);
+		const std::size_t ncount = (nul != nullptr) ?
+			static_cast<std::size_t> (static_cast<const char *> (nul) - cvalues) : count;
+		const std::size_t start = std::min<std::size_t>(offset, slot->length);
+		const std::size_t written = std::min<std::size_t>(ncount, slot->size - start);
+
+		std::memcpy(impl_payload<char>(slot) + start, cvalues, written);
+		slot->length = static_cast<std::uint32_t> (start + written);
+	}
+
+	template <typename S>
+	static XPLMDataRef
+	impl_register_scalar(const char *name, const DatarefSpec& spec, impl_slot *slot) {
+		return XPLMRegisterDataAccessor(
+				name,
+				spec.type, spec.writable,
+				impl_dr_read_scalar<S, int>, impl_dr_write_scalar<S, int>,
+				impl_dr_read_scalar<S, float>, impl_dr_write_scalar<S, float>,
+				impl_dr_read_scalar<S, double>, impl_dr_write_scalar<S, double>,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				slot, slot);
+	}
+
+	template <typename S>
+	static XPLMDataRef
+	impl_register_array(const char *name, const DatarefSpec& spec, impl_slot *slot) {
+		return XPLMRegisterDataAccessor(
+				name,
+				spec.type, spec.writable,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				impl_dr_read_array<S, int>, impl_dr_write_array<S, int>,
+				impl_dr_read_array<S, float>, impl_dr_write_array<S, float>,
+				nullptr, nullptr,
+				slot, slot);
+	}
+
+	static XPLMDataRef
+	impl_register(const char *name, const DatarefSpec& spec, impl_slot *slot) {
+		switch (spec.type) {
+			case xplmType_Int:
+				return impl_register_scalar<int>(name, spec, slot);
+			case xplmType_Float:
+				return impl_register_scalar<float>(name, spec, slot);
+			case xplmType_Double:
+				return impl_register_scalar<double>(name, spec, slot);
+			case xplmType_IntArray:
+				return impl_register_array<int>(name, spec, slot);
+			case xplmType_FloatArray:
+				return impl_register_array<float>(name, spec, slot);
+			default:
+				return XPLMRegisterDataAccessor(
+						name,
+						spec.type, spec.writable,
+						nullptr, nullptr,
+						nullptr, nullptr,
+						nullptr, nullptr,
+						nullptr, nullptr,
+						nullptr, nullptr,
+						impl_dr_read_b, impl_dr_write_b,
+						slot, slot);
+		}
+	}
+
+	// One entry per table row, in table order.
+	std::vector<XPLMDataRef> locs;
+	std::vector<XPLMDataTypeID> types;
+	std::vector<impl_slot *> slots;
+	std::vector<std::uint32_t> name_offsets;
+
+	std::unique_ptr<char[]> names;
+	std::unique_ptr<unsigned char[]> values;
+};
+
+// Streaming codecs for recorded columns
+//
+// GorillaEncoder stores each float or double as the XOR with the previous
+// one: an unchanged value costs one bit, and a small change costs only the
+// bits that differ, framed by a leading-zero count and a length that are
+// reused while the changes fit the same window. DeltaOfDeltaEncoder stores
+// integers and timestamps as zigzag varints of the change in their delta,
+// one byte for a steady counter or frame clock. Both append to a byte
+// vector; each decoder reads back exactly what its encoder wrote.
+
+// Most significant bit first.
+class impl_bit_writer {
+public:
+	explicit impl_bit_writer(std::vector<unsigned char>& o) : out(o) {}
+
+	void
+	write(std::uint64_t bits, unsigned count) {
+		if (count > 32) {
+			impl_write(bits >> 32, count - 32);
+			count = 32;
+		}
+		impl_write(bits, count);
+	}
+
+	// Pads the last byte with zeros.
+	void
+	flush() {
+		if (fill > 0) {
+			out.push_back(static_cast<unsigned char> (acc << (8 - fill)));
+			acc = 0;
+			fill = 0;
+		}
+	}
+private:
+	void
+	impl_write(std::uint64_t bits, unsigned count) {
+		if (count == 0) {
+			return;
+		}
+		acc = (acc << count) | (bits & ((std::uint64_t(1) << count) - 1));
+		fill += count;
+		while (fill >= 8) {
+			fill -= 8;
+			out.push_back(static_cast<unsigned char> (acc >> fill));
+		}
+		acc &= (std::uint64_t(1) << fill) - 1;
+	}
+
+	std::vector<unsigned char>& out;
+	std::uint64_t acc { 0 };
+	unsigned fill { 0 };
+};
+
+// Reads past the end as zeros.
+class impl_bit_reader {
+public:
+	impl_bit_reader(const unsigned char *data, std::size_t size) : p(data), end(data + size) {}
+
+	std::uint64_t
+	read(unsigned count) noexcept {
+		if (count > 32) {
+			const std::uint64_t hi = impl_read(count - 32);
+			return (hi << 32) | impl_read(32);
+		}
+		return impl_read(count);
+	}
+private:
+	std::uint64_t
+	impl_read(unsigned count) noexcept {
+		if (count == 0) {
+			return 0;
+		}
+		while (fill < count) {
+			acc = (acc << 8) | ((p < end) ? *p++ : 0);
+			fill += 8;
+		}
+		fill -= count;
+		const std::uint64_t v = (acc >> fill) & ((std::uint64_t(1) << count) - 1);
+		acc &= (std::uint64_t(1) << fill) - 1;
+		return v;
+	}
+
+	const unsigned char *p;
+	const unsigned char *end;
+	std::uint64_t acc { 0 };
+	unsigned fill { 0 };
+};
+
+template <typename F>
+struct impl_gorilla_traits {
+	static_assert(std::is_same<F, float>::value || std::is_same<F, double>::value,
+		"Gorilla coding is for float and double");
+	using bits_type = typename std::conditional<sizeof(F) == 4, std::uint32_t, std::uint64_t>::type;
+	static constexpr unsigned width = sizeof(F) * 8;
+	static constexpr unsigned length_bits = (sizeof(F) == 4) ? 5 : 6;
+};
+
+template <typename F>
+class GorillaEncoder {
+public:
+	explicit GorillaEncoder(std::vector<unsigned char>& out) : writer(out) {}
+
+	void
+	push(F value) {
+		using traits = impl_gorilla_traits<F>;
+		typename traits::bits_type cur;
+		std::memcpy(&cur, &value, sizeof(cur));
+
+		if (count++ == 0) {
+			writer.write(cur, traits::width);
+			prev = cur;
+			return;
+		}
+
+		const std::uint64_t x = cur ^ prev;
+		prev = cur;
+		if (x == 0) {
+			writer.write(0, 1);
+			return;
+		}
+
+		const unsigned lead = std::min(31u, impl_leading_zeros(x) - (64 - traits::width));
+		const unsigned trail = impl_trailing_zeros(x);
+
+		// Reuse the previous window when the change fits inside it.
+		if (has_window && lead >= prev_lead && trail >= prev_trail) {
+			writer.write(2, 2);
+			writer.write(x >> prev_trail, traits::width - prev_lead - prev_trail);
+			return;
+		}
+
+		const unsigned meaningful = traits::width - lead - trail;
+		writer.write(3, 2);
+		writer.write(lead, 5);
+		writer.write(meaningful - 1, traits::length_bits);
+		writer.write(x >> trail, meaningful);
+		prev_lead = lead;
+		prev_trail = trail;
+		has_window = true;
+	}
+
+	// Call once after the last push().
+	void
+	finish() {
+		writer.flush();
+	}
+private:
+	impl_bit_writer writer;
+	std::uint64_t count { 0 };
+	typename impl_gorilla_traits<F>::bits_type prev { 0 };
+	unsigned prev_lead { 0 };
+	unsigned prev_trail { 0 };
+	bool has_window { false };
+};
+
+template <typename F>
+class GorillaDecoder {
+public:
+	GorillaDecoder(const unsigned char *data, std::size_t size) : reader(data, size) {}
+
+	F
+	next() noexcept {
+		using traits = impl_gorilla_traits<F>;
+
+		if (count++ == 0) {
+			prev = static_cast<typename traits::bits_type> (reader.read(traits::width));
+		} else if (reader.read(1) == 1) {
+			if (reader.read(1) == 1) {
+				lead = static_cast<unsigned> (reader.read(5));
+				const unsigned meaningful = static_cast<unsigned> (reader.read(traits::length_bits)) + 1;
+				trail = traits::width - lead - meaningful;
+			}
+			const unsigned meaningful = traits::width - lead - trail;
+			prev ^= static_cast<typename traits::bits_type> (reader.read(meaningful) << trail);
+		}
+
+		F value;
+		std::memcpy(&value, &prev, sizeof(value));
+		return value;
+	}
+private:
+	impl_bit_reader reader;
+	std::uint64_t count { 0 };
+	typename impl_gorilla_traits<F>::bits_type prev { 0 };
+	unsigned lead { 0 };
+	unsigned trail { 0 };
+};
+
+class DeltaOfDeltaEncoder {
+public:
+	explicit DeltaOfDeltaEncoder(std::vector<unsigned char>& o) : out(o) {}
+
+	void
+	push(std::int64_t value) {
+		// Unsigned, so wrapping differences stay defined.
+		const std::uint64_t v = static_cast<std::uint64_t> (value);
+		const std::uint64_t delta = v - prev;
+
+		impl_put(count == 0 ? v : (count == 1 ? delta : delta - prev_delta));
+		++count;
+		prev = v;
+		prev_delta = delta;
+	}
+private:
+	void
+	impl_put(std::uint64_t v) {
+		// Zigzag, then LEB128.
+		std::uint64_t z = (v << 1) ^ (0 - (v >> 63));
+		while (z >= 0x80) {
+			out.push_back(static_cast<unsigned char> (z | 0x80));
+			z >>= 7;
+		}
+		out.push_back(static_cast<unsigned char> (z));
+	}
+
+	std::vector<unsigned char>& out;
+	std::uint64_t count { 0 };
+	std::uint64_t prev { 0 };
+	std::uint64_t prev_delta { 0 };
+};
+
+class DeltaOfDeltaDecoder {
+public:
+	DeltaOfDeltaDecoder(const unsigned char *data, std::size_t size) : p(data), end(data + size) {}
+
+	std::int64_t
+	next() noexcept {
+		const std::uint64_t v = impl_get();
+		if (count == 0) {
+			prev = v;
+		} else {
+			prev_delta = (count == 1) ? v : prev_delta + v;
+			prev += prev_delta;
+		}
+		++count;
+		return static_cast<std::int64_t> (prev);
+	}
+private:
+	std::uint64_t
+	impl_get() noexcept {
+		std::uint64_t z = 0;
+		for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+			const unsigned char b = *p++;
+			z |= static_cast<std::uint64_t> (b & 0x7f) << shift;
+			if ((b & 0x80) == 0) {
+				break;
+			}
+		}
+		return (z >> 1) ^ (0 - (z & 1));
+	}
+
+	const unsigned char *p;
+	const unsigned char *end;
+	std::uint64_t count { 0 };
+	std::uint64_t prev { 0 };
+	std::uint64_t prev_delta { 0 };
+};
+
+// Recording files
+//
+// Append-only, native byte order, everything 8-byte aligned:
+//
+//	RecordingFileHeader
+//	per column: RecordingColumnHeader, then the path (no terminator)
+//	padding to data_offset
+//	blocks of block_frames frames, the last one possibly part full:
+//		RecordingBlockHeader
+//		time_us[block_frames], sequence[block_frames]
+//		per column: value[block_frames], padded to 8 bytes
+//	seek index: RecordingIndexEntry per block
+//	RecordingFileTrailer
+//
+// Blocks are columnar, so a reader pulls one dataref's history without
+// touching the rest. Uncompressed blocks are block_bytes each, so block k
+// starts at data_offset + k * block_bytes.
+//
+// With RecordingCodec::xor_delta each block instead holds its header, then
+// per stream (times, sequences, each column) a uint32 byte count and the
+// stream: Gorilla for floats and doubles, delta-of-delta for the rest. It
+// is padded to 8 bytes and the header gives its size.
+//
+// The index and trailer are only written on a clean close; a file cut short
+// still reads up to its last complete block.
+
+struct RecordingFileHeader {
+	char magic[8];			// "DRWREC1"
+	std::uint32_t version;
+	std::uint32_t column_count;
+	std::uint32_t block_frames;
+	std::uint32_t codec;		// RecordingCodec
+	std::uint64_t block_bytes;	// decoded size of a block
+	std::uint64_t data_offset;
+};
+
+struct RecordingColumnHeader {
+	std::uint32_t type;		// xplmType_Int, _Float or _Double
+	std::uint32_t path_length;
+};
+
+struct RecordingBlockHeader {
+	std::uint32_t frames;
+	std::uint32_t bytes;		// on disk, header included
+};
+
+struct RecordingIndexEntry {
+	std::int64_t first_time_us;
+	std::uint64_t first_sequence;
+	std::uint64_t offset;		// of the block, from the start of the file
+};
+
+struct RecordingFileTrailer {
+	std::uint64_t index_offset;
+	std::uint64_t block_count;
+	std::uint64_t frame_count;
+	char magic[8];			// "DRWIDX1"
+};
+
+constexpr std::uint32_t recording_format_version = 2;
+
+enum class RecordingCodec : std::uint32_t {
+	none = 0,
+	xor_delta = 1,
+};
+
+DATAREFW_NODISCARD inline std::size_t
+impl_recording_width(std::uint32_t type) noexcept {
+	return (type == xplmType_Double) ? sizeof(double) : sizeof(std::int32_t);
+}
+
+DATAREFW_NODISCARD inline std::size_t
+impl_round8(std::size_t n) noexcept {
+	return (n + 7) & ~static_cast<std::size_t> (7);
+}
+
+// Where each column's values start inside a block, shared by the writer and
+// the reader.
+DATAREFW_NODISCARD inline std::vector<std::size_t>
+impl_recording_block_offsets(const std::vector<std::uint32_t>& types,
+	std::size_t block_frames, std::size_t& block_bytes) {
+	std::vector<std::size_t> offsets;
+	std::size_t pos = sizeof(RecordingBlockHeader) + 2 * block_frames * sizeof(std::int64_t);
+	for (auto t : types) {
+		offsets.push_back(pos);
+		pos += impl_round8(block_frames * impl_recording_width(t));
+	}
+	block_bytes = pos;
+	return offsets;
+}
+
+// RecorderSink writing the format above. Frames are transposed into an
+// in-memory block and written, compressed or not, a whole block at a time
+// on the recorder's thread.
+class RecordingFileSink : public RecorderSink {
+public:
+	explicit RecordingFileSink(const std::string& file_path, std::size_t frames_per_block = 256,
+		RecordingCodec block_codec = RecordingCodec::none) :
+		file(std::fopen(file_path.c_str(), "wb")), block_frames(frames_per_block), codec(block_codec) {
+		DATAREFW_ASSERT(block_frames > 0);
+	}
+
+	RecordingFileSink(const RecordingFileSink& o) = delete;
+	RecordingFileSink& operator=(const RecordingFileSink& o) = delete;
+
+	DATAREFW_NODISCARD bool
+	is_open() const noexcept {
+		return (file != nullptr);
+	}
+
+	void
+	begin(const RecorderLayout& layout) override {
+		std::vector<std::uint32_t> types;
+		for (const auto& c : layout.columns) {
+			types.push_back(static_cast<std::uint32_t> (c.type));
+			src_offsets.push_back(c.offset);
+		}
+		std::size_t block_bytes = 0;
+		dst_offsets = impl_recording_block_offsets(types, block_frames, block_bytes);
+		block.assign(block_bytes, 0);
+		column_types = types;
+		widths.clear();
+		for (auto t : types) {
+			widths.push_back(impl_recording_width(t));
+		}
+
+		std::size_t data_offset = sizeof(RecordingFileHeader);
+		for (const auto& c : layout.columns) {
+			data_offset += sizeof(RecordingColumnHeader) + c.path.size();
+		}
+		data_offset = impl_round8(data_offset);
+
+		RecordingFileHeader header {};
+		std::memcpy(header.magic, "DRWREC1", 8);
+		header.version = recording_format_version;
+		header.column_count = static_cast<std::uint32_t> (layout.columns.size());
+		header.block_frames = static_cast<std::uint32_t> (block_frames);
+		header.codec = static_cast<std::uint32_t> (codec);
+		header.block_bytes = block_bytes;
+		header.data_offset = data_offset;
+		impl_write(&header, sizeof(header));
+
+		for (const auto& c : layout.columns) {
+			const RecordingColumnHeader col { static_cast<std::uint32_t> (c.type),
+				static_cast<std::uint32_t> (c.path.size()) };
+			impl_write(&col, sizeof(col));
+			impl_write(c.path.data(), c.path.size());
+		}
+
+		const char pad[8] = {};
+		impl_write(pad, data_offset - written);
+	}
+
+	void
+	write(const unsigned char *frame) override {
+		RecordedFrame header;
+		std::memcpy(&header, frame, sizeof(header));
+
+		if (block_used == 0) {
+			index.push_back(RecordingIndexEntry { header.time_us, header.sequence, 0 });
+		}
+
+		unsigned char *base = block.data();
+		const std::size_t times = sizeof(RecordingBlockHeader);
+		const std::size_t sequences = times + block_frames * sizeof(std::int64_t);
+		std::memcpy(base + times + block_used * sizeof(std::int64_t), &header.time_us, sizeof(std::int64_t));
+		std::memcpy(base + sequences + block_used * sizeof(std::uint64_t), &header.sequence, sizeof(std::uint64_t));
+
+		const std::size_t n = widths.size();
+		for (std::size_t c = 0; c < n; ++c) {
+			std::memcpy(base + dst_offsets[c] + block_used * widths[c], frame + src_offsets[c], widths[c]);
+		}
+
+		++frame_count;
+		if (++block_used == block_frames) {
+			impl_flush_block();
+		}
+	}
+
+	void
+	end() override {
+		if (block_used > 0) {
+			impl_flush_block();
+		}
+
+		RecordingFileTrailer trailer {};
+		trailer.index_offset = written;
+		trailer.block_count = index.size();
+		trailer.frame_count = frame_count;
+		std::memcpy(trailer.magic, "DRWIDX1", 8);
+
+		impl_write(index.data(), index.size() * sizeof(RecordingIndexEntry));
+		impl_write(&trailer, sizeof(trailer));
+
+		if (file != nullptr) {
+			std::fflush(file);
+		}
+	}
+
+	~RecordingFileSink() override {
+		if (file != nullptr) {
+			std::fclose(file);
+		}
+	}
+private:
+	void
+	impl_write(const void *data, std::size_t bytes) noexcept {
+		if (file != nullptr && bytes > 0) {
+			std::fwrite(data, 1, bytes, file);
+		}
+		written += bytes;
+	}
+
+	// Part-full blocks keep the full size; the header says how many frames
+	// are real.
+	void
+	impl_flush_block() {
+		index.back().offset = written;
+
+		if (codec == RecordingCodec::xor_delta) {
+			impl_encode_block();
+		} else {
+			const RecordingBlockHeader header { static_cast<std::uint32_t> (block_used),
+				static_cast<std::uint32_t> (block.size()) };
+			std::memcpy(block.data(), &header, sizeof(header));
+			impl_write(block.data(), block.size());
+		}
+		block_used = 0;
+	}
+
+	void
+	impl_encode_block() {
+		encoded.assign(sizeof(RecordingBlockHeader), 0);
+		const unsigned char *base = block.data();
+		const std::size_t times = sizeof(RecordingBlockHeader);
+
+		impl_encode_integers<std::int64_t>(base + times);
+		impl_encode_integers<std::uint64_t>(base + times + block_frames * sizeof(std::int64_t));
+
+		for (std::size_t c = 0; c < column_types.size(); ++c) {
+			const unsigned char *src = base + dst_offsets[c];
+			if (column_types[c] == xplmType_Float) {
+				impl_encode_floats<float>(src);
+			} else if (column_types[c] == xplmType_Double) {
+				impl_encode_floats<double>(src);
+			} else {
+				impl_encode_integers<std::int32_t>(src);
+			}
+		}
+
+		encoded.resize(impl_round8(encoded.size()), 0);
+		const RecordingBlockHeader header { static_cast<std::uint32_t> (block_used),
+			static_cast<std::uint32_t> (encoded.size()) };
+		std::memcpy(encoded.data(), &header, sizeof(header));
+		impl_write(encoded.data(), encoded.size());
+	}
+
+	// Leaves room for the stream's byte count, fills it in once known.
+	std::size_t
+	impl_begin_stream() {
+		const std::size_t at = encoded.size();
+		encoded.resize(at + sizeof(std::uint32_t), 0);
+		return at;
+	}
+
+	void
+	impl_end_stream(std::size_t at) {
+		const auto bytes = static_cast<std::uint32_t> (encoded.size() - at - sizeof(std::uint32_t));
+		std::memcpy(encoded.data() + at, &bytes, sizeof(bytes));
+	}
+
+	template <typename V>
+	void
+	impl_encode_integers(const unsigned char *src) {
+		const std::size_t at = impl_begin_stream();
+		DeltaOfDeltaEncoder enc(encoded);
+		for (std::size_t i = 0; i < block_used; ++i) {
+			V v;
+			std::memcpy(&v, src + i * sizeof(V), sizeof(V));
+			enc.push(static_cast<std::int64_t> (v));
+		}
+		impl_end_stream(at);
+	}
+
+	template <typename F>
+	void
+	impl_encode_floats(const unsigned char *src) {
+		const std::size_t at = impl_begin_stream();
+		GorillaEncoder<F> enc(encoded);
+		for (std::size_t i = 0; i < block_used; ++i) {
+			F v;
+			std::memcpy(&v, src + i * sizeof(F), sizeof(F));
+			enc.push(v);
+		}
+		enc.finish();
+		impl_end_stream(at);
+	}
+
+	std::FILE *file;
+	const std::size_t block_frames;
+	const RecordingCodec codec;
+	std::vector<std::uint32_t> column_types;
+	std::vector<std::size_t> src_offsets;
+	std::vector<std::size_t> dst_offsets;
+	std::vector<std::size_t> widths;
+	std::vector<unsigned char> block;
+	std::vector<unsigned char> encoded;
+	std::size_t block_used { 0 };
+	std::vector<RecordingIndexEntry> index;
+	std::uint64_t frame_count { 0 };
+	std::uint64_t written { 0 };
+};
+
+// Read-only view of a recording file, memory-mapped where the platform
+// allows it (read into memory on Windows). Uncompressed values are read in
+// place; nothing is parsed beyond the header and the seek index. Compressed
+// blocks are decoded whole, one at a time, the first time a frame in them
+// is read.
+class RecordingReader {
+public:
+	using size_type = std::size_t;
+
+	explicit RecordingReader(const std::string& file_path) {
+		impl_map(file_path);
+		if (base != nullptr && !impl_parse()) {
+			impl_unmap();
+		}
+	}
+
+	RecordingReader(const RecordingReader& o) = delete;
+	RecordingReader& operator=(const RecordingReader& o) = delete;
+
+	DATAREFW_NODISCARD bool
+	is_open() const noexcept {
+		return (base != nullptr);
+	}
+
+	DATAREFW_NODISCARD size_type
+	columns() const noexcept {
+		return types.size();
+	}
+
+	DATAREFW_NODISCARD const std::string&
+	path(size_type column) const noexcept {
+		DATAREFW_ASSERT(column < columns());
+		return paths[column];
+	}
+
+	DATAREFW_NODISCARD XPLMDataTypeID
+	type(size_type column) const noexcept {
+		DATAREFW_ASSERT(column < columns());
+		return static_cast<XPLMDataTypeID> (types[column]);
+	}
+
+	// Column of path, or columns() if it wasn't recorded.
+	DATAREFW_NODISCARD size_type
+	column_of(const std::string& dr_path) const noexcept {
+		for (size_type i = 0; i < paths.size(); ++i) {
+			if (paths[i] == dr_path) {
+				return i;
+			}
+		}
+		return columns();
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	frames() const noexcept {
+		return frame_count;
+	}
+
+	DATAREFW_NODISCARD std::int64_t
+	time_us(std::uint64_t frame) const noexcept {
+		return impl_load<std::int64_t>(impl_block(frame) + sizeof(RecordingBlockHeader),
+			frame % block_frames);
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	sequence(std::uint64_t frame) const noexcept {
+		return impl_load<std::uint64_t>(impl_block(frame) + sizeof(RecordingBlockHeader) +
+			block_frames * sizeof(std::int64_t), frame % block_frames);
+	}
+
+	// Pointer to the stored value, type(column) wide. For compressed files
+	// it is only valid until a frame in another block is read.
+	DATAREFW_NODISCARD const unsigned char *
+	raw(size_type column, std::uint64_t frame) const noexcept {
+		DATAREFW_ASSERT(column < columns());
+		return impl_block(frame) + offsets[column] +
+			(frame % block_frames) * impl_recording_width(types[column]);
+	}
+
+	// The value converted to V, whatever it was recorded as.
+	template <typename V>
+	DATAREFW_NODISCARD V
+	value(size_type column, std::uint64_t frame) const noexcept {
+		const unsigned char *src = raw(column, frame);
+		switch (types[column]) {
+			case xplmType_Int:
+				return static_cast<V> (impl_load<std::int32_t>(src, 0));
+			case xplmType_Float:
+				return static_cast<V> (impl_load<float>(src, 0));
+			default:
+				return static_cast<V> (impl_load<double>(src, 0));
+		}
+	}
+
+	// The last frame recorded at or before t, or 0 if t is before the start.
+	DATAREFW_NODISCARD std::uint64_t
+	frame_at(std::int64_t t) const noexcept {
+		if (frame_count == 0) {
+			return 0;
+		}
+
+		// Last block starting at or before t, then within it.
+		auto it = std::upper_bound(block_times.begin(), block_times.end(), t);
+		if (it == block_times.begin()) {
+			return 0;
+		}
+		const std::uint64_t block = static_cast<std::uint64_t> (it - block_times.begin() - 1);
+		std::uint64_t lo = block * block_frames;
+		std::uint64_t hi = std::min<std::uint64_t>(lo + block_frames, frame_count);
+		while (hi - lo > 1) {
+			const std::uint64_t mid = lo + (hi - lo) / 2;
+			if (time_us(mid) <= t) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		return lo;
+	}
+
+	~RecordingReader() {
+		impl_unmap();
+	}
+private:
+	template <typename V>
+	static V
+	impl_load(const unsigned char *src, std::uint64_t index) noexcept {
+		V v;
+		std::memcpy(&v, src + index * sizeof(V), sizeof(V));
+		return v;
+	}
+
+	const unsigned char *
+	impl_block(std::uint64_t frame) const noexcept {
+		DATAREFW_ASSERT(frame < frame_count);
+		const std::uint64_t k = frame / block_frames;
+		if (codec == RecordingCodec::none) {
+			return base + block_offsets[k];
+		}
+		if (k != decoded_block) {
+			impl_decode(k);
+		}
+		return decoded.data();
+	}
+
+	// Expands block k into the uncompressed layout. Its header was checked
+	// against the file when the index was loaded.
+	void
+	impl_decode(std::uint64_t k) const noexcept {
+		const unsigned char *src = base + block_offsets[k];
+		RecordingBlockHeader bh;
+		std::memcpy(&bh, src, sizeof(bh));
+		const unsigned char *end = src + bh.bytes;
+		const unsigned char *pos = src + sizeof(bh);
+
+		decoded.assign(block_bytes, 0);
+		unsigned char *dst = decoded.data();
+		std::memcpy(dst, &bh, sizeof(bh));
+
+		const std::size_t times = sizeof(RecordingBlockHeader);
+		impl_decode_integers<std::int64_t>(pos, end, bh.frames, dst + times);
+		impl_decode_integers<std::uint64_t>(pos, end, bh.frames,
+			dst + times + block_frames * sizeof(std::int64_t));
+
+		for (std::size_t c = 0; c < types.size(); ++c) {
+			if (types[c] == xplmType_Float) {
+				impl_decode_floats<float>(pos, end, bh.frames, dst + offsets[c]);
+			} else if (types[c] == xplmType_Double) {
+				impl_decode_floats<double>(pos, end, bh.frames, dst + offsets[c]);
+			} else {
+				impl_decode_integers<std::int32_t>(pos, end, bh.frames, dst + offsets[c]);
+			}
+		}
+
+		decoded_block = k;
+	}
+
+	// The next stream's bytes, clamped to the block, and moves pos past it.
+	static std::size_t
+	impl_next_stream(const unsigned char *& pos, const unsigned char *end) noexcept {
+		std::uint32_t bytes = 0;
+		if (end - pos >= static_cast<std::ptrdiff_t> (sizeof(bytes))) {
+			std::memcpy(&bytes, pos, sizeof(bytes));
+			pos += sizeof(bytes);
+		}
+		const std::size_t n = std::min<std::size_t>(bytes, static_cast<std::size_t> (end - pos));
+		pos += n;
+		return n;
+	}
+
+	template <typename V>
+	static void
+	impl_decode_integers(const unsigned char *& pos, const unsigned char *end,
+		std::uint32_t frames, unsigned char *dst) noexcept {
+		const std::size_t n = impl_next_stream(pos, end);
+		DeltaOfDeltaDecoder dec(pos - n, n);
+		for (std::uint32_t i = 0; i < frames; ++i) {
+			const V v = static_cast<V> (dec.next());
+			std::memcpy(dst + i * sizeof(V), &v, sizeof(V));
+		}
+	}
+
+	template <typename F>
+	static void
+	impl_decode_floats(const unsigned char *& pos, const unsigned char *end,
+		std::uint32_t frames, unsigned char *dst) noexcept {
+		const std::size_t n = impl_next_stream(pos, end);
+		GorillaDecoder<F> dec(pos - n, n);
+		for (std::uint32_t i = 0; i < frames; ++i) {
+			const F v = dec.next();
+			std::memcpy(dst + i * sizeof(F), &v, sizeof(F));
+		}
+	}
+
+	bool
+	impl_parse() {
+		RecordingFileHeader header;
+		if (size < sizeof(header)) {
+			return false;
+		}
+		std::memcpy(&header, base, sizeof(header));
+		if (std::memcmp(header.magic, "DRWREC1", 8) != 0 ||
+			header.version != recording_format_version || header.block_frames == 0 ||
+			header.codec > static_cast<std::uint32_t> (RecordingCodec::xor_delta)) {
+			return false;
+		}
+
+		codec = static_cast<RecordingCodec> (header.codec);
+		block_frames = header.block_frames;
+		block_bytes = header.block_bytes;
+		data_offset = header.data_offset;
+
+		size_type pos = sizeof(header);
+		for (std::uint32_t c = 0; c < header.column_count; ++c) {
+			RecordingColumnHeader col;
+			if (pos + sizeof(col) > size) {
+				return false;
+			}
+			std::memcpy(&col, base + pos, sizeof(col));
+			pos += sizeof(col);
+			if (pos + col.path_length > size) {
+				return false;
+			}
+			types.push_back(col.type);
+			paths.emplace_back(reinterpret_cast<const char *> (base + pos), col.path_length);
+			pos += col.path_length;
+		}
+
+		size_type expected = 0;
+		offsets = impl_recording_block_offsets(types, block_frames, expected);
+		if (expected != block_bytes || data_offset > size) {
+			return false;
+		}
+
+		impl_load_index();
+		return true;
+	}
+
+	// From the trailer after a clean close, otherwise from the complete
+	// blocks that made it to disk. A trailer or index that doesn't agree with
+	// the blocks it points at is ignored the same way.
+	void
+	impl_load_index() {
+		if (!impl_load_trailer_index()) {
+			block_times.clear();
+			block_offsets.clear();
+			impl_walk_blocks();
+		}
+	}
+
+	// Whether a block header at pos fits before limit and matches the file's
+	// layout. Everything impl_block() and impl_decode() later read is
+	// checked here.
+	bool
+	impl_block_fits(std::uint64_t pos, std::uint64_t limit, RecordingBlockHeader& bh) const noexcept {
+		if (pos < data_offset || pos > limit || limit - pos < sizeof(bh)) {
+			return false;
+		}
+		std::memcpy(&bh, base + pos, sizeof(bh));
+		const bool sized = (codec == RecordingCodec::none) ?
+			(bh.bytes == block_bytes) : (bh.bytes >= sizeof(bh));
+		return (bh.frames != 0 && bh.frames <= block_frames && sized && bh.bytes <= limit - pos);
+	}
+
+	bool
+	impl_load_trailer_index() {
+		RecordingFileTrailer trailer {};
+		if (size < data_offset + sizeof(trailer)) {
+			return false;
+		}
+		std::memcpy(&trailer, base + size - sizeof(trailer), sizeof(trailer));
+
+		const std::uint64_t index_end = size - sizeof(trailer);
+		if (std::memcmp(trailer.magic, "DRWIDX1", 8) != 0 ||
+			trailer.index_offset < data_offset || trailer.index_offset > index_end ||
+			(index_end - trailer.index_offset) % sizeof(RecordingIndexEntry) != 0 ||
+			(index_end - trailer.index_offset) / sizeof(RecordingIndexEntry) != trailer.block_count ||
+			trailer.frame_count > trailer.block_count * block_frames) {
+			return false;
+		}
+
+		// Uncompressed blocks are all the same size and packed.
+		if (codec == RecordingCodec::none &&
+			trailer.index_offset != data_offset + trailer.block_count * block_bytes) {
+			return false;
+		}
+
+		// Only the last block can be part full, and together they hold
+		// exactly frame_count frames.
+		std::uint64_t frames = 0;
+		for (std::uint64_t b = 0; b < trailer.block_count; ++b) {
+			RecordingIndexEntry entry;
+			std::memcpy(&entry, base + trailer.index_offset + b * sizeof(entry), sizeof(entry));
+
+			RecordingBlockHeader bh;
+			if (!impl_block_fits(entry.offset, trailer.index_offset, bh) ||
+				(b + 1 < trailer.block_count && bh.frames != block_frames)) {
+				return false;
+			}
+			frames += bh.frames;
+			block_times.push_back(entry.first_time_us);
+			block_offsets.push_back(entry.offset);
+		}
+		if (frames != trailer.frame_count) {
+			return false;
+		}
+
+		frame_count = trailer.frame_count;
+		return true;
+	}
+
+	// Walk the blocks; the first one that's incomplete ends the file.
+	void
+	impl_walk_blocks() {
+		frame_count = 0;
+		std::uint64_t pos = data_offset;
+		RecordingBlockHeader bh;
+		while (impl_block_fits(pos, size, bh)) {
+			block_offsets.push_back(pos);
+			frame_count += bh.frames;
+			block_times.push_back(time_us(frame_count - bh.frames));
+			pos += bh.bytes;
+			if (bh.frames < block_frames) {
+				break;
+			}
+		}
+	}
+
+#if IBM
+	void
+	impl_map(const std::string& file_path) {
+		std::FILE *f = std::fopen(file_path.c_str(), "rb");
+		if (f == nullptr) {
+			return;
+		}
+		std::fseek(f, 0, SEEK_END);
+		const long len = std::ftell(f);
+		std::fseek(f, 0, SEEK_SET);
+		if (len > 0) {
+			contents.resize(static_cast<size_type> (len));
+			if (std::fread(contents.data(), 1, contents.size(), f) == contents.size()) {
+				base = contents.data();
+				size = contents.size();
+			}
+		}
+		std::fclose(f);
+	}
+
+	void
+	impl_unmap() noexcept {
+		base = nullptr;
+		size = 0;
+		contents.clear();
+	}
+
+	std::vector<unsigned char> contents;
+#else
+	void
+	impl_map(const std::string& file_path) {
+		const int fd = ::open(file_path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return;
+		}
+		struct stat st;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+			void *p = ::mmap(nullptr, static_cast<size_type> (st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				base = static_cast<const unsigned char *> (p);
+				size = static_cast<size_type> (st.st_size);
+			}
+		}
+		::close(fd);
+	}
+
+	void
+	impl_unmap() noexcept {
+		if (base != nullptr) {
+			::munmap(const_cast<unsigned char *> (base), size);
+		}
+		base = nullptr;
+		size = 0;
+	}
+#endif // IBM
+
+	const unsigned char *base { nullptr };
+	size_type size { 0 };
+	RecordingCodec codec { RecordingCodec::none };
+	std::uint64_t block_frames { 0 };
+	std::uint64_t block_bytes { 0 };
+	std::uint64_t data_offset { 0 };
+	std::uint64_t frame_count { 0 };
+	std::vector<std::uint32_t> types;
+	std::vector<std::string> paths;
+	std::vector<std::size_t> offsets;
+	std::vector<std::int64_t> block_times;
+	std::vector<std::uint64_t> block_offsets;
+	mutable std::vector<unsigned char> decoded;
+	mutable std::uint64_t decoded_block { static_cast<std::uint64_t> (-1) };
+};
+
+// Plays a recording back into datarefs, from a flight loop or a test:
+//
+//	RecordingReader reader("flight.drw");
+//	RecordingReplay replay(reader);
+//	replay.bind_xplm();		// every recorded path that is writable, or
+//	replay.bind("myplugin/ias", my_create_dataref);
+//	replay.set_speed(4.0);
+//
+//	// every frame
+//	replay.advance(elapsed_seconds);
+//
+// Sim datarefs are bound by path and resolved lazily through the shared
+// registry, so ones registered later, or looked up again after
+// reset_dataref_registry(), are replayed too; resolve() looks up the missing
+// ones again. A frame costs one copy per target.
+class RecordingReplay {
+public:
+	using size_type = std::size_t;
+
+	explicit RecordingReplay(const RecordingReader& r) : reader(r) {
+		DATAREFW_ASSERT(reader.is_open());
+		if (reader.frames() > 0) {
+			start_us = reader.time_us(0);
+		}
+	}
+
+	// Sends each recorded column to the dataref of the same path, whenever
+	// that is writable and takes the recorded type. Returns how many are
+	// right now.
+	size_type
+	bind_xplm() {
+		for (size_type c = 0; c < reader.columns(); ++c) {
+			targets.push_back(impl_target { c, intern_dataref(reader.path(c)),
+				nullptr, false, nullptr, nullptr });
+		}
+		return resolve();
+	}
+
+	// Looks up the bound sim datarefs that are still missing. Returns how
+	// many bound ones can be replayed into.
+	size_type
+	resolve() {
+		size_type n = 0;
+		for (auto& t : targets) {
+			if (t.dr != nullptr) {
+				continue;
+			}
+			if (t.record->loc == nullptr) {
+				intern_dataref(t.record->name);
+			}
+			n += impl_check_target(t) ? 1 : 0;
+		}
+		return n;
+	}
+
+	// Sends the column recorded as path to dr. Returns false if there is
+	// none, or it was recorded as another type than T.
+	template <typename T, std::size_t N>
+	bool
+	bind(const std::string& dr_path, CreateDataref<T, N>& dr) {
+		static_assert(dr_type_is_number<T>::value, "Only scalars are recorded");
+		const size_type c = reader.column_of(dr_path);
+		if (c == reader.columns() || !dataref_type_matches<T>(reader.type(c))) {
+			return false;
+		}
+		targets.push_back(impl_target { c, nullptr, nullptr, false, &dr, impl_assign_create<T, N> });
+		return true;
+	}
+
+	// 1.0 is the recorded pace.
+	void
+	set_speed(double factor) noexcept {
+		speed = factor;
+	}
+
+	// Moves the replay clock on by elapsed seconds times the speed and
+	// applies the frame recorded at that point. Returns false once past the
+	// end.
+	bool
+	advance(double elapsed) {
+		clock_us += elapsed * speed * 1e6;
+		const auto t = start_us + static_cast<std::int64_t> (clock_us);
+		if (reader.frames() == 0) {
+			return false;
+		}
+		const auto frame = reader.frame_at(t);
+		if (frame != current || !applied) {
+			apply(frame);
+		}
+		return (t <= reader.time_us(reader.frames() - 1));
+	}
+
+	// Applies one frame directly, e.g. to step through a recording.
+	void
+	apply(std::uint64_t frame) {
+		for (auto& t : targets) {
+			const unsigned char *src = reader.raw(t.column, frame);
+			if (t.dr != nullptr) {
+				t.assign(t.dr, src);
+				continue;
+			}
+
+			if (!impl_check_target(t)) {
+				continue;
+			}
+			const std::uint32_t type = reader.type(t.column);
+			if (type == xplmType_Int) {
+				XPLMSetDatai(t.checked, impl_load<std::int32_t>(src));
+			} else if (type == xplmType_Float) {
+				XPLMSetDataf(t.checked, impl_load<float>(src));
+			} else {
+				XPLMSetDatad(t.checked, impl_load<double>(src));
+			}
+		}
+		current = frame;
+		applied = true;
+	}
+
+	// Back to the first frame. Doesn't look anything up; see resolve().
+	void
+	rewind() noexcept {
+		clock_us = 0.0;
+		applied = false;
+	}
+
+	DATAREFW_NODISCARD std::uint64_t
+	frame() const noexcept {
+		return current;
+	}
+private:
+	// Either a sim dataref through its record, or a CreateDataref.
+	struct impl_target {
+		size_type column;
+		const impl_dataref_record *record;
+		XPLMDataRef checked;	// handle usable was worked out for
+		bool usable;
+		void *dr;
+		void (*assign)(void *dr, const unsigned char *src);
+	};
+
+	// Once per new handle: writable, and takes the recorded type as is.
+	bool
+	impl_check_target(impl_target& t) const noexcept {
+		const auto rec = t.record;
+		if (rec->loc == nullptr) {
+			return false;
+		}
+		if (rec->loc != t.checked) {
+			t.checked = rec->loc;
+			t.usable = rec->writable && (rec->types & reader.type(t.column)) != 0;
+		}
+		return t.usable;
+	}
+
+	template <typename V>
+	static V
+	impl_load(const unsigned char *src) noexcept {
+		V v;
+		std::memcpy(&v, src, sizeof(V));
+		return v;
+	}
+
+	// bind() made sure the column was recorded as T.
+	template <typename T, std::size_t N>
+	static void
+	impl_assign_create(void *dr, const unsigned char *src) {
+		*static_cast<CreateDataref<T, N> *> (dr) = impl_load<T>(src);
+	}
+
+	const RecordingReader& reader;
+	std::vector<impl_target> targets;
+	std::int64_t start_us { 0 };
+	double clock_us { 0.0 };
+	double speed { 1.0 };
+	std::uint64_t current { 0 };
+	bool applied { false };
+};
+
+// Registration and read callbacks shared by datarefs that other plugins can
+// only read, and whose value comes from Derived::impl_value() rather than a
+// plain member (ConcurrentCreateDataref, ComputedDataref).
+template <typename Derived, typename T, std::size_t ARRAY_SIZE>
+class impl_readonly_dataref {
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using storage_type = typename impl_create_storage<T, ARRAY_SIZE>::type;
+
+	impl_readonly_dataref() = default;
+	impl_readonly_dataref(const impl_readonly_dataref& dr_o) = delete;
+	impl_readonly_dataref& operator=(const impl_readonly_dataref& dr_o) = delete;
+
+	explicit
+	operator bool() const noexcept {
+		return (dataref_loc != nullptr);
+	}
+
+	DATAREFW_NODISCARD std::string
+	path() const {
+		return dataref_name;
+	}
 
-	explicit
-	operator bool() const noexcept {
-		return (dataref_loc != nullptr);
+	~impl_readonly_dataref() {
+		if (dataref_loc) {
+			XPLMUnregisterDataAccessor(dataref_loc);
+			dataref_loc = nullptr;
+		}
+	}
+protected:
+	void
+	impl_create_dataref(const std::string& pdr_path) {
+		DATAREFW_ASSERT(pdr_path != "");
+		DATAREFW_ASSERT(pdr_path.find(' ') == std::string::npos);
+
+		verify_types<T>();
+		static_assert(!dr_type_is_array<T>::value || ARRAY_SIZE > 0,
+			"Array size can't be zero.");
+
+		dataref_name = pdr_path;
+		impl_dr_get_datatype();
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+		callback_latency = impl_callback_latency_for(dataref_name);
+#endif
+		impl_register_dataref_accessor();
+	}
+private:
+	static impl_readonly_dataref *
+	impl_base_of(void *refcon) {
+		DATAREFW_ASSERT(refcon != nullptr);
+		return static_cast<impl_readonly_dataref *> (refcon);
+	}
+
+	static const storage_type&
+	impl_value_of(void *refcon) {
+		return static_cast<Derived *> (impl_base_of(refcon))->impl_value();
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_i(void *refcon) {
+		DATAREFW_TIMED_CALLBACK(impl_base_of(refcon), reads);
+		return static_cast<int> (impl_value_of(refcon));
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static float
+	impl_dr_read_f(void *refcon) {
+		DATAREFW_TIMED_CALLBACK(impl_base_of(refcon), reads);
+		return static_cast<float> (impl_value_of(refcon));
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	static double
+	impl_dr_read_d(void *refcon) {
+		DATAREFW_TIMED_CALLBACK(impl_base_of(refcon), reads);
+		return static_cast<double> (impl_value_of(refcon));
+	}
+
+	template <typename U, typename V = T,
+		typename std::enable_if<dr_type_is_array<V>::value, V>::type* = nullptr>
+	static int
+	impl_dr_read_tmplt_arr(void *refcon, U *values, int offset, int max) {
+		// Fixed sizes are answered without touching the value.
+		if (values == nullptr && ARRAY_SIZE != dynamic_array_size) {
+			return static_cast<int> (ARRAY_SIZE);
+		}
+
+		const auto& storage = impl_value_of(refcon);
+		const int a_sz = static_cast<int> (storage.size());
+
+		if (values == nullptr) {
+			return a_sz;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz || max <= 0) {
+			return 0;
+		}
+
+		const int upper_limit = std::min(max, a_sz - offset);
+		impl_copy_elements(values, storage.data() + offset, upper_limit);
+
+		return upper_limit;
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_vi(void *refcon, int *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_base_of(refcon), reads);
+		return impl_dr_read_tmplt_arr<int>(refcon, values, offset, max);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_vf(void *refcon, float *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_base_of(refcon), reads);
+		return impl_dr_read_tmplt_arr<float>(refcon, values, offset, max);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	static int
+	impl_dr_read_b(void *refcon, void *values, int offset, int max) {
+		DATAREFW_TIMED_CALLBACK(impl_base_of(refcon), reads);
+		const auto& storage = impl_value_of(refcon);
+		const int a_sz = static_cast<int> (storage.size());
+
+		if (values == nullptr) {
+			return a_sz;
+		}
+
+		DATAREFW_ASSERT(offset >= 0);
+
+		if (offset >= a_sz || max <= 0) {
+			return 0;
+		}
+
+		const int upper_limit = std::min(max, a_sz - offset);
+		char *cvalues = static_cast<char *> (values);
+
+		std::memcpy(cvalues, storage.data() + offset, upper_limit);
+
+		// Terminate c-strings for readers that left room for it.
+		if (upper_limit < max) {
+			cvalues[upper_limit] = '\0';
+		}
+
+		return upper_limit;
+	}
+
+	void
+	impl_dr_get_datatype() {
+		if (std::is_same<T, int>::value) {
+			dataref_types = xplmType_Int;
+		} else if (std::is_same<T, float>::value) {
+			dataref_types = xplmType_Float;
+		} else if (std::is_same<T, double>::value) {
+			dataref_types = xplmType_Double;
+		} else if (std::is_same<T, DrIntArr>::value) {
+			dataref_types = xplmType_IntArray;
+		} else if (std::is_same<T, DrFloatArr>::value) {
+			dataref_types = xplmType_FloatArray;
+		} else if (dr_type_is_byte<T>::value) {
+			dataref_types = xplmType_Data;
+		}
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	impl_register_dataref_accessor() {
+		dataref_loc = XPLMRegisterDataAccessor(
+				dataref_name.c_str(),
+				dataref_types, 0,
+				impl_dr_read_i, nullptr,
+				impl_dr_read_f, nullptr,
+				impl_dr_read_d, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				this, nullptr);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	void
+	impl_register_dataref_accessor() {
+		dataref_loc = XPLMRegisterDataAccessor(
+				dataref_name.c_str(),
+				dataref_types, 0,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				impl_dr_read_vi, nullptr,
+				impl_dr_read_vf, nullptr,
+				nullptr, nullptr,
+				this, nullptr);
+	}
+
+	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	void
+	impl_register_dataref_accessor() {
+		dataref_loc = XPLMRegisterDataAccessor(
+				dataref_name.c_str(),
+				dataref_types, 0,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				nullptr, nullptr,
+				impl_dr_read_b, nullptr,
+				this, nullptr);
+	}
+
+	std::string dataref_name;
+	XPLMDataRef dataref_loc { nullptr };
+	XPLMDataTypeID dataref_types { xplmType_Unknown };
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+	impl_callback_latency *callback_latency { nullptr };
+#endif
+};
+
+// A CreateDataref whose value is produced on another thread. One worker
+// publish()es whole values; the sim's read callbacks always see the last
+// complete one, without locks and without waiting on the worker.
+//
+// Backed by a triple buffer: the worker fills a buffer nobody else touches
+// and swaps it in with one atomic exchange, and the read side swaps the
+// newest buffer out the same way. Neither side ever retries or blocks. Only
+// one thread may publish, and the dataref is read-only to other plugins.
+//
+// Supports the scalar types, fixed-size DrIntArr/DrFloatArr (N elements) and
+// FixedString<M>.
+template <typename T, std::size_t ARRAY_SIZE = 0>
+class ConcurrentCreateDataref :
+	public impl_readonly_dataref<ConcurrentCreateDataref<T, ARRAY_SIZE>, T, ARRAY_SIZE> {
+public:
+	using storage_type = typename impl_create_storage<T, ARRAY_SIZE>::type;
+	using size_type = std::size_t;
+
+	ConcurrentCreateDataref() = default;
+
+	ConcurrentCreateDataref(const std::string& pdr_path) {
+		create_dataref(pdr_path);
+	}
+
+	void
+	create_dataref(const std::string& pdr_path) {
+		static_assert(!std::is_same<T, std::string>::value,
+			"Use FixedString<N> for strings published from another thread");
+		static_assert(ARRAY_SIZE != dynamic_array_size,
+			"Arrays published from another thread need a fixed size");
+
+		this->impl_create_dataref(pdr_path);
+	}
+
+	// Worker thread only.
+	void
+	publish(const storage_type& value) {
+		buffers[back].value = value;
+		impl_swap_back();
+	}
+
+	// Worker thread only. fn gets the back buffer holding the last published
+	// value and changes what it needs, e.g. a few elements of a large array.
+	template <typename F>
+	void
+	update(F&& fn) {
+		buffers[back].value = buffers[last_published].value;
+		fn(buffers[back].value);
+		impl_swap_back();
+	}
+
+	// Sim thread only: the value other plugins currently see.
+	DATAREFW_NODISCARD const storage_type&
+	latest() noexcept {
+		return impl_value();
+	}
+
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	DATAREFW_NODISCARD static constexpr size_type
+	size() noexcept {
+		return ARRAY_SIZE;
+	}
+private:
+	friend class impl_readonly_dataref<ConcurrentCreateDataref<T, ARRAY_SIZE>, T, ARRAY_SIZE>;
+
+	static constexpr unsigned impl_dirty = 4;
+
+	void
+	impl_swap_back() noexcept {
+		last_published = back;
+		back = middle.exchange(back | impl_dirty, std::memory_order_acq_rel) & 3;
+	}
+
+	const storage_type&
+	impl_value() noexcept {
+		if (middle.load(std::memory_order_relaxed) & impl_dirty) {
+			front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+		}
+		return buffers[front].value;
+	}
+
+	// Cache lines apart, so the worker filling one doesn't slow down the
+	// sim thread reading another. Padded rather than alignas(64), like
+	// FrameRing, so the dataref can be allocated with plain new.
+	struct impl_buffer {
+		storage_type value;
+		char impl_pad[64];
+	};
+
+	char impl_pad0[64];
+	std::array<impl_buffer, 3> buffers {{}};
+	// Index of the buffer between the two sides, plus impl_dirty when the
+	// worker has put a newer one there than the read side holds.
+	std::atomic<unsigned> middle { 1 };
+	unsigned back { 0 };			// worker only
+	unsigned last_published { 1 };		// worker only
+	unsigned front { 2 };			// sim thread only
+	char impl_pad1[64];
+};
+
+// A read-only dataref whose value is derived on demand. compute runs only
+// when another plugin actually reads it, at most once per sim cycle
+// (XPLMGetCycleNumber()); every other read in the same cycle gets the
+// memoized result. Nothing is computed for a dataref nobody reads.
+//
+//	ComputedDataref<float> dist("myplugin/nav/dist_to_wpt", [] {
+//		return great_circle_nm(own_pos(), active_wpt());
+//	});
+template <typename T, std::size_t ARRAY_SIZE = 0>
+class ComputedDataref :
+	public impl_readonly_dataref<ComputedDataref<T, ARRAY_SIZE>, T, ARRAY_SIZE> {
+public:
+	using storage_type = typename impl_create_storage<T, ARRAY_SIZE>::type;
+	using compute_type = std::function<storage_type()>;
+
+	ComputedDataref() = default;
+
+	ComputedDataref(const std::string& pdr_path, compute_type pcompute) {
+		create_dataref(pdr_path, std::move(pcompute));
+	}
+
+	void
+	create_dataref(const std::string& pdr_path, compute_type pcompute) {
+		DATAREFW_ASSERT(pcompute != nullptr);
+		compute = std::move(pcompute);
+		this->impl_create_dataref(pdr_path);
+	}
+
+	// Recompute on the next read even within the same frame, e.g. after the
+	// inputs changed mid-frame.
+	void
+	invalidate() noexcept {
+		cache_cycle = 0;
+	}
+
+	// The memoized value, computing it if this cycle hasn't yet.
+	DATAREFW_NODISCARD const storage_type&
+	get() {
+		return impl_value();
+	}
+private:
+	friend class impl_readonly_dataref<ComputedDataref<T, ARRAY_SIZE>, T, ARRAY_SIZE>;
+
+	// Keyed on the sim's own cycle count rather than advance_frame(), so it
+	// doesn't depend on the plugin using the FindDataref frame cache.
+	const storage_type&
+	impl_value() {
+		const auto cycle = static_cast<std::uint64_t> (XPLMGetCycleNumber()) + 1;
+		if (cache_cycle != cycle) {
+			cache_value = compute();
+			cache_cycle = cycle;
+		}
+		return cache_value;
+	}
+
+	compute_type compute;
+	std::uint64_t cache_cycle { 0 };	// cycle number + 1, 0 for none
+	storage_type cache_value { };
+};
+
+
+// One queued DatarefProxy request. Reads of the same dataref and type in one
+// batch are served by a single XPLM call, made by the first of them.
+struct impl_proxy_request {
+	impl_proxy_request() = default;
+	impl_proxy_request(const impl_proxy_request& o) = delete;
+	impl_proxy_request& operator=(const impl_proxy_request& o) = delete;
+	virtual ~impl_proxy_request() = default;
+
+	// Sim thread only: reads into the request, or writes from it. Sets found
+	// to false, without touching the sim, when the dataref is missing, of
+	// another type, or read-only for a write.
+	virtual void
+	run(const impl_dataref_record *record) = 0;
+
+	// Sim thread only: takes the value another read of the same type got.
+	virtual void
+	share(const impl_proxy_request& leader) = 0;
+
+	virtual void
+	complete() = 0;
+
+	impl_proxy_request *next { nullptr };
+	std::string path;
+	const void *type_key { nullptr };
+	bool is_write { false };
+	bool found { false };
+};
+
+// Numbers DatarefProxy batches across every proxy, so a record's
+// proxy_leader from an earlier batch is never mistaken for a current one.
+template <typename Dummy = void>
+struct impl_proxy_batches {
+	static std::uint64_t current;
+};
+
+template <typename Dummy>
+std::uint64_t impl_proxy_batches<Dummy>::current = 0;
+
+// Failed requests leave the promise unset, so the future reports
+// std::future_errc::broken_promise once the request is dropped.
+template <typename T>
+struct impl_proxy_promise {
+	void
+	operator()(T&& value, bool found) {
+		if (found) {
+			promise.set_value(std::move(value));
+		}
+	}
+
+	std::promise<T> promise;
+};
+
+template <>
+struct impl_proxy_promise<void> {
+	void
+	operator()(bool found) {
+		if (found) {
+			promise.set_value();
+		}
+	}
+
+	std::promise<void> promise;
+};
+
+template <typename T, typename F>
+struct impl_proxy_read : impl_proxy_request {
+	explicit impl_proxy_read(F&& f) : done(std::move(f)) {
+		type_key = &impl_type_key<T>::id;
+	}
+
+	void
+	run(const impl_dataref_record *record) override {
+		found = (record->loc != nullptr && dataref_type_matches<T>(record->types));
+		if (found) {
+			FindDataref<T> dr;
+			dr.impl_attach(record);
+			value = dr;
+		}
+	}
+
+	void
+	share(const impl_proxy_request& leader) override {
+		value = static_cast<const impl_proxy_read&> (leader).value;
+		found = leader.found;
+	}
+
+	void
+	complete() override {
+		done(std::move(value), found);
+	}
+
+	T value { };
+	F done;
+};
+
+template <typename T, typename F>
+struct impl_proxy_write : impl_proxy_request {
+	impl_proxy_write(const T& v, F&& f) : value(v), done(std::move(f)) {
+		type_key = &impl_type_key<T>::id;
+		is_write = true;
+	}
+
+	void
+	run(const impl_dataref_record *record) override {
+		found = (record->loc != nullptr && record->writable &&
+			dataref_type_matches<T>(record->types));
+		if (found) {
+			FindDataref<T> dr;
+			dr.impl_attach(record);
+			dr = value;
+		}
+	}
+
+	void
+	share(const impl_proxy_request&) override {
+		DATAREFW_ASSERT(false);
+	}
+
+	void
+	complete() override {
+		done(found);
+	}
+
+	T value;
+	F done;
+};
+
+// Lets threads other than the sim's read and write datarefs. Requests from
+// any thread go onto a lock-free queue, and a flight loop owned by the proxy
+// runs the whole queue once per frame on the sim thread:
+//
+//	DatarefProxy proxy;	// in XPluginStart/Enable, on the sim thread
+//
+//	// any thread
+//	std::future<float> ias = proxy.read<float>("sim/flightmodel/position/indicated_airspeed");
+//	proxy.write<int>("sim/cockpit/switches/gear_handle_status", 1);
+//	proxy.read<DrFloatArr>("sim/flightmodel/engine/ENGN_N1_", [](DrFloatArr&& n1, bool found) { ... });
+//
+// Futures are fulfilled, and callbacks called, on the sim thread once the
+// whole batch the request was taken in has run. Reads of the same dataref queued
+// in the same frame share one XPLM call, unless a write to that dataref was
+// queued between them. Requests run in queue order. One naming an invalid
+// path (empty, or with a space) or a dataref that doesn't exist, has another
+// type, or (for writes) is read-only fails: the callback gets
+// found == false, and the future's get() throws
+// std::future_error with std::future_errc::broken_promise.
+//
+// Stop the threads using the proxy before destroying it. Whatever is still
+// queued by then runs in the destructor.
+class DatarefProxy {
+public:
+	DatarefProxy() {
+		XPLMRegisterFlightLoopCallback(impl_flight_loop, -1.0f, this);
+	}
+
+	DatarefProxy(const DatarefProxy& o) = delete;
+	DatarefProxy& operator=(const DatarefProxy& o) = delete;
+
+	template <typename T>
+	DATAREFW_NODISCARD std::future<T>
+	read(const std::string& path) {
+		impl_proxy_promise<T> done;
+		auto result = done.promise.get_future();
+		read<T>(path, std::move(done));
+		return result;
+	}
+
+	// on_value(T&&, bool found) is called on the sim thread.
+	template <typename T, typename F>
+	void
+	read(const std::string& path, F on_value) {
+		verify_types<T>();
+		impl_push(new impl_proxy_read<T, F>(std::move(on_value)), path);
+	}
+
+	template <typename T>
+	std::future<void>
+	write(const std::string& path, const T& value) {
+		impl_proxy_promise<void> done;
+		auto result = done.promise.get_future();
+		write<T>(path, value, std::move(done));
+		return result;
+	}
+
+	// on_done(bool found) is called on the sim thread once the value is set,
+	// or the write failed.
+	template <typename T, typename F>
+	void
+	write(const std::string& path, const T& value, F on_done) {
+		verify_types<T>();
+		impl_push(new impl_proxy_write<T, F>(value, std::move(on_done)), path);
 	}
 
-	DATAREFW_NODISCARD auto
-	path() const {
-		return dataref_name;
+	// Runs everything queued so far and returns how many requests that was.
+	// The proxy's flight loop calls this every frame; only ever call it from
+	// the sim thread.
+	std::size_t
+	process() {
+		impl_proxy_request *batch = head.load(std::memory_order_relaxed);
+		if (batch == nullptr) {
+			return 0;
+		}
+		batch = head.exchange(nullptr, std::memory_order_acquire);
+
+		// Pushed newest first; reverse into queue order.
+		impl_proxy_request *ordered = nullptr;
+		while (batch != nullptr) {
+			auto next = batch->next;
+			batch->next = ordered;
+			ordered = batch;
+			batch = next;
+		}
+
+		const std::uint64_t batch_id = ++impl_proxy_batches<>::current;
+		while (ordered != nullptr) {
+			std::unique_ptr<impl_proxy_request> req(ordered);
+			ordered = ordered->next;
+
+			// Paths intern_dataref() would assert on just fail the request.
+			if (req->path.empty() || req->path.find(' ') != std::string::npos) {
+				req->found = false;
+				batch_done.push_back(std::move(req));
+				continue;
+			}
+
+			const auto record = intern_dataref(req->path);
+			if (req->is_write) {
+				req->run(record);
+				record->proxy_leader = nullptr;
+			} else {
+				auto leader = (record->proxy_batch == batch_id) ?
+					static_cast<const impl_proxy_request *> (record->proxy_leader) : nullptr;
+				if (leader != nullptr && leader->type_key == req->type_key) {
+					req->share(*leader);
+				} else {
+					req->run(record);
+					record->proxy_leader = req.get();
+					record->proxy_batch = batch_id;
+				}
+			}
+
+			batch_done.push_back(std::move(req));
+		}
+
+		// Only once every read has taken its value from its leader.
+		for (auto& req : batch_done) {
+			req->complete();
+		}
+
+		const std::size_t count = batch_done.size();
+		batch_done.clear();
+		return count;
 	}
 
-	~CreateDataref() {
-		impl_dr_cleanup();
+	~DatarefProxy() {
+		XPLMUnregisterFlightLoopCallback(impl_flight_loop, this);
+		process();
 	}
 private:
-	template <typename U, std::size_t ARR_SIZE = 0>
-	static CreateDataref<U, ARR_SIZE> *
-	impl_proc_ref(void *refcon) {
-		DATAREFW_ASSERT(refcon != nullptr);
-		return reinterpret_cast<CreateDataref<U, ARR_SIZE> *> (refcon);
+	static float
+	impl_flight_loop(float, float, int, void *refcon) {
+		static_cast<DatarefProxy *> (refcon)->process();
+		return -1.0f;
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
-	static void
-	impl_dr_write_byte(void *refcon, void *values, int offset, int count) {
-		if (values == nullptr || offset >= count || count == 0) {
-			return;
+	void
+	impl_push(impl_proxy_request *req, const std::string& path) {
+		req->path = path;
+		req->next = head.load(std::memory_order_relaxed);
+		while (!head.compare_exchange_weak(req->next, req,
+			std::memory_order_release, std::memory_order_relaxed)) {
 		}
+	}
 
-		DATAREFW_ASSERT(offset >= 0);
-
-		auto ncount = count - offset;
-		char *cvalues = static_cast<char *> (values);
-		char *temp_val = new char[count + 1];
-		const auto odr = impl_proc_ref<std::string>(refcon);
+	// Producers push onto this stack; process() takes all of it at once.
+	std::atomic<impl_proxy_request *> head { nullptr };
 
-		cvalues += offset; // Read from offset
-		std::memcpy(temp_val, cvalues, ncount);
+	// Sim thread only, reused every frame.
+	std::vector<std::unique_ptr<impl_proxy_request>> batch_done;
+};
 
-		// Ensure proper null-termination on c-strings
-		if (temp_val[ncount] != '\0') {
-			temp_val[ncount] = '\0';
-		}
 
-		odr->dataref_storage = std::string(temp_val);
-		delete[] temp_val;
-	}
+#ifdef DATAREFW_HAS_COROUTINES
 
-	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
-	DATAREFW_NODISCARD static int
-	impl_dr_read_byte(void *refcon, void *values, int offset, int max) {
-		const auto odr = impl_proc_ref<std::string>(refcon);
-		const int a_sz = static_cast<int> (odr->dataref_storage.size());
+class FrameScheduler;
 
-		if (values == nullptr) {
-			return a_sz;
+// A coroutine that a FrameScheduler runs frame by frame, for sequences that
+// would otherwise be hand-written state machines:
+//
+//	FrameTask
+//	extend_gear(FindDataref<int>& gear_handle, FindDataref<float>& gear_ratio) {
+//		gear_handle = 1;
+//		co_await until(gear_ratio, [](float r) { return r > 0.99f; });
+//		co_await next_frame(30);
+//		...
+//	}
+//
+//	scheduler.spawn(extend_gear(handle, ratio));
+//
+// Nothing runs until the task is spawned. Tasks can only await the
+// awaitables below.
+class FrameTask {
+public:
+	struct promise_type {
+		FrameTask
+		get_return_object() noexcept {
+			return FrameTask(std::coroutine_handle<promise_type>::from_promise(*this));
 		}
 
-		DATAREFW_ASSERT(offset >= 0);
-
-		int upper_limit;
-		if ((offset + max) < a_sz) {
-			upper_limit = max;
-		} else {
-			upper_limit = a_sz;
+		std::suspend_always
+		initial_suspend() noexcept {
+			return {};
 		}
 
-		char *cvalues = static_cast<char *>(values);
-		char *dr_str = &odr->dataref_storage[0];
+		// The frame frees itself when the body returns.
+		std::suspend_never
+		final_suspend() noexcept {
+			return {};
+		}
 
-		dr_str += offset; // Offset
-		std::memcpy(values, dr_str, upper_limit);
+		void
+		return_void() noexcept {
+		}
 
-		// Ensure proper null-termination on c-strings
-		if (cvalues[upper_limit] != '\0') {
-			cvalues[upper_limit] = '\0';
+		void
+		unhandled_exception() noexcept {
+			std::terminate();
 		}
 
-		return upper_limit;
-	}
+		FrameScheduler *scheduler { nullptr };
+	};
 
-	template <typename U, typename V = T, std::size_t ARR_SIZE = ARRAY_SIZE,
-		typename std::enable_if<dr_type_is_array<V>::value, V>::type* = nullptr>
-	static void
-	impl_dr_write_tmplt_arr(void *refcon, U *values, int offset, int count) {
-		const auto odr = impl_proc_ref<T, ARR_SIZE>(refcon);
+	using handle_type = std::coroutine_handle<promise_type>;
 
-		if (values == nullptr) {
-			return;
-		}
+	FrameTask(FrameTask&& o) noexcept : handle(std::exchange(o.handle, nullptr)) {}
 
-		DATAREFW_ASSERT(offset >= 0);
+	FrameTask(const FrameTask& o) = delete;
+	FrameTask& operator=(const FrameTask& o) = delete;
+	FrameTask& operator=(FrameTask&& o) = delete;
 
-		for (auto i = 0; i < count; ++i) {
-			U *value_ptr = values;
-			value_ptr += offset;
-			odr->dataref_storage[i] = *value_ptr;
+	// Only a task that was never spawned still owns its frame.
+	~FrameTask() {
+		if (handle) {
+			handle.destroy();
 		}
 	}
+private:
+	friend class FrameScheduler;
 
-	template <typename U, typename V = T, std::size_t ARR_SIZE = ARRAY_SIZE,
-		typename std::enable_if<dr_type_is_array<V>::value, V>::type* = nullptr>
-	DATAREFW_NODISCARD static int
-	impl_dr_read_tmplt_arr(void *refcon, U *values, int offset, int max) {
-		const auto odr = impl_proc_ref<T, ARR_SIZE>(refcon);
-		const int a_sz = static_cast<int> (odr->dataref_storage.size());
+	explicit FrameTask(handle_type h) noexcept : handle(h) {}
 
-		if (values == nullptr) {
-			return a_sz;
-		}
+	handle_type handle;
+};
 
-		DATAREFW_ASSERT(offset >= 0);
+// A task suspended on a dataref. impl_offer() sees the value read for this
+// frame and says whether to resume; a null value means the dataref went away
+// or changed type, and always resumes.
+struct impl_frame_waiter {
+	virtual ~impl_frame_waiter() = default;
 
-		int upper_limit;
-		if ((offset + max) < a_sz) {
-			upper_limit = max;
-		} else {
-			upper_limit = a_sz;
-		}
+	virtual bool
+	impl_offer(const void *value) = 0;
 
-		for (auto i = 0; i < upper_limit; ++i) {
-			values[i] = odr->dataref_storage[i + offset];
-		}
+	FrameTask::handle_type handle;
+};
 
-		return upper_limit;
-	}
+// Every task waiting on the same dataref and type, and the one read per
+// frame that serves them.
+struct impl_frame_group {
+	impl_frame_group(const impl_dataref_record *r, const void *key) : record(r), type_key(key) {}
+	impl_frame_group(const impl_frame_group& o) = delete;
+	impl_frame_group& operator=(const impl_frame_group& o) = delete;
+	virtual ~impl_frame_group() = default;
+
+	// Null when the record can't be read as the group's type this frame.
+	virtual const void *
+	read() = 0;
+
+	const impl_dataref_record *record;
+	const void *type_key;
+	std::vector<impl_frame_waiter *> waiters;
+};
 
-	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
-	static int
-	impl_dr_read_i(void *refcon) {
-		return impl_proc_ref<T>(refcon)->dataref_storage;
-	}
+// Whether an awaiter on record can ever be served as T.
+template <typename T>
+DATAREFW_NODISCARD bool
+impl_frame_readable(const impl_dataref_record *record) noexcept {
+	return (record->loc != nullptr && dataref_type_matches<T>(record->types));
+}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
-	static void
-	impl_dr_write_i(void *refcon, int val) {
-		impl_proc_ref<T>(refcon)->dataref_storage = val;
+template <typename T>
+struct impl_frame_group_of : impl_frame_group {
+	explicit impl_frame_group_of(const impl_dataref_record *r) :
+		impl_frame_group(r, &impl_type_key<T>::id) {
+		dr.impl_attach(r);
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
-	static float
-	impl_dr_read_f(void *refcon) {
-		return impl_proc_ref<T>(refcon)->dataref_storage;
+	const void *
+	read() override {
+		// Checked every frame: the registry can be reset under a live group.
+		if (!impl_frame_readable<T>(record)) {
+			return nullptr;
+		}
+		impl_read();
+		return &value;
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
-	static void
-	impl_dr_write_f(void *refcon, float val) {
-		impl_proc_ref<T>(refcon)->dataref_storage = val;
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
+	void
+	impl_read() noexcept {
+		value = dr;
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
-	static double
-	impl_dr_read_d(void *refcon) {
-		return impl_proc_ref<T>(refcon)->dataref_storage;
+	// Reuses value's storage instead of building a new vector every frame.
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
+	void
+	impl_read() {
+		value.resize(dr.size());
+		value.resize(dr.read_into(value.data(), value.size()));
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
-	static void
-	impl_dr_write_d(void *refcon, double val) {
-		impl_proc_ref<T>(refcon)->dataref_storage = val;
+	template <typename U = T,
+		typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
+	void
+	impl_read() {
+		dr.read_into(value);
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	static int
-	impl_dr_read_vi(void *refcon, int *values, int offset, int max) {
-		return impl_dr_read_tmplt_arr<int>(refcon, values, offset, max);
+	FindDataref<T> dr;
+	T value { };
+};
+
+// Runs FrameTasks from its own flight loop. Each frame it resumes the tasks
+// whose wait is over, in the order they started waiting; tasks that wait
+// on the same dataref share a single read of it.
+//
+// Create it, spawn tasks and destroy it on the sim thread. Tasks still
+// suspended when it is destroyed are destroyed along with it.
+class FrameScheduler {
+public:
+	FrameScheduler() {
+		XPLMRegisterFlightLoopCallback(impl_flight_loop, -1.0f, this);
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	static void
-	impl_dr_write_vi(void *refcon, int *values, int offset, int max) {
-		impl_dr_write_tmplt_arr<int>(refcon, values, offset, max);
+	FrameScheduler(const FrameScheduler& o) = delete;
+	FrameScheduler& operator=(const FrameScheduler& o) = delete;
+
+	// Runs the task up to its first co_await, right away.
+	void
+	spawn(FrameTask task) {
+		auto h = std::exchange(task.handle, nullptr);
+		DATAREFW_ASSERT(h);
+		h.promise().scheduler = this;
+		h.resume();
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	static int
-	impl_dr_read_vf(void *refcon, float *values, int offset, int max) {
-		return impl_dr_read_tmplt_arr<float>(refcon, values, offset, max);
+	// Frames run by this scheduler so far.
+	DATAREFW_NODISCARD std::uint64_t
+	frame() const noexcept {
+		return frame_count;
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	static void
-	impl_dr_write_vf(void *refcon, float *values, int offset, int max) {
-		impl_dr_write_tmplt_arr<float>(refcon, values, offset, max);
+	// Suspended tasks.
+	DATAREFW_NODISCARD std::size_t
+	waiting() const noexcept {
+		std::size_t n = sleepers.size();
+		for (const auto& g : groups) {
+			n += g->waiters.size();
+		}
+		return n;
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
-	static int
-	impl_dr_read_b(void *refcon, void *values, int offset, int max) {
-		return impl_dr_read_byte(refcon, values, offset, max);
+	~FrameScheduler() {
+		XPLMUnregisterFlightLoopCallback(impl_flight_loop, this);
+
+		std::vector<FrameTask::handle_type> handles;
+		for (const auto& s : sleepers) {
+			handles.push_back(s.handle);
+		}
+		for (const auto& g : groups) {
+			for (auto w : g->waiters) {
+				handles.push_back(w->handle);
+			}
+		}
+
+		sleepers.clear();
+		groups.clear();
+		for (auto h : handles) {
+			h.destroy();
+		}
 	}
+private:
+	template <typename T, typename P>
+	friend class impl_until_awaiter;
+	friend struct impl_frame_awaiter;
 
-	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
-	static void
-	impl_dr_write_b(void *refcon, void *values, int offset, int max) {
-		impl_dr_write_byte(refcon, values, offset, max);
+	struct impl_sleeper {
+		FrameTask::handle_type handle;
+		std::uint64_t due;
+	};
+
+	void
+	impl_sleep(FrameTask::handle_type h, unsigned frames) {
+		sleepers.push_back(impl_sleeper { h, frame_count + frames });
 	}
 
+	template <typename T>
 	void
-	impl_dr_get_datatype() {
-		if (std::is_same<T, int>::value) {
-			dataref_types = xplmType_Int;
-		} else if (std::is_same<T, float>::value) {
-			dataref_types = xplmType_Float;
-		} else if (std::is_same<T, double>::value) {
-			dataref_types = xplmType_Double;
-		} else if (std::is_same<T, DrIntArr>::value) {
-			dataref_types = xplmType_IntArray;
-		} else if (std::is_same<T, DrFloatArr>::value) {
-			dataref_types = xplmType_FloatArray;
-		} else if (std::is_same<T, std::string>::value) {
-			dataref_types = xplmType_Data;
+	impl_watch(const impl_dataref_record *record, impl_frame_waiter *w) {
+		const void *key = &impl_type_key<T>::id;
+		for (auto& g : groups) {
+			if (g->record == record && g->type_key == key) {
+				g->waiters.push_back(w);
+				return;
+			}
 		}
+		groups.emplace_back(new impl_frame_group_of<T>(record));
+		groups.back()->waiters.push_back(w);
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_number<U>::value, U>::type* = nullptr>
 	void
-	register_dataref_accessor() {
-		dataref_loc = XPLMRegisterDataAccessor(
-				dataref_name.c_str(),
-				dataref_types, dataref_writable,
-				impl_dr_read_i, impl_dr_write_i,
-				impl_dr_read_f, impl_dr_write_f,
-				impl_dr_read_d, impl_dr_write_d,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				this, this);
+	impl_tick() {
+		++frame_count;
+
+		// Decide who wakes before waking anyone, so tasks that wait again
+		// while resumed wait for the next frame.
+		ready.clear();
+		sleepers.erase(std::remove_if(sleepers.begin(), sleepers.end(),
+			[this](const impl_sleeper& s) {
+				if (s.due > frame_count) {
+					return false;
+				}
+				ready.push_back(s.handle);
+				return true;
+			}), sleepers.end());
+
+		for (auto& g : groups) {
+			if (g->waiters.empty()) {
+				continue;
+			}
+
+			// A null value resumes every waiter with a failure.
+			const void *value = g->read();
+			g->waiters.erase(std::remove_if(g->waiters.begin(), g->waiters.end(),
+				[this, value](impl_frame_waiter *w) {
+					if (!w->impl_offer(value)) {
+						return false;
+					}
+					ready.push_back(w->handle);
+					return true;
+				}), g->waiters.end());
+		}
+
+		const std::size_t n = ready.size();
+		for (std::size_t i = 0; i < n; ++i) {
+			ready[i].resume();
+		}
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	void
-	register_dataref_accessor() {
-		dataref_loc = XPLMRegisterDataAccessor(
-				dataref_name.c_str(),
-				dataref_types, dataref_writable,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				impl_dr_read_vi, impl_dr_write_vi,
-				impl_dr_read_vf, impl_dr_write_vf,
-				nullptr, nullptr,
-				this, this);
-		dataref_storage.resize(ARRAY_SIZE);
+	static float
+	impl_flight_loop(float, float, int, void *refcon) {
+		static_cast<FrameScheduler *> (refcon)->impl_tick();
+		return -1.0f;
+	}
+
+	std::uint64_t frame_count { 0 };
+	std::vector<impl_sleeper> sleepers;
+	// Kept once created; a group without waiters costs nothing per frame.
+	std::vector<std::unique_ptr<impl_frame_group>> groups;
+	std::vector<FrameTask::handle_type> ready;
+};
+
+struct impl_frame_awaiter {
+	bool
+	await_ready() const noexcept {
+		return (frames == 0);
 	}
 
-	template <typename U = T, typename std::enable_if<dr_type_is_byte<U>::value, U>::type* = nullptr>
 	void
-	register_dataref_accessor() {
-		dataref_loc = XPLMRegisterDataAccessor(
-				dataref_name.c_str(),
-				dataref_types, dataref_writable,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				nullptr, nullptr,
-				impl_dr_read_b, impl_dr_write_b,
-				this, this);
+	await_suspend(FrameTask::handle_type h) {
+		h.promise().scheduler->impl_sleep(h, frames);
 	}
 
-	// I'm sure there's a more *elaborate* way to do the following of which I'm not aware of:
-	template <std::size_t ARR_SIZE = ARRAY_SIZE, typename U = T,
-		typename std::enable_if<dr_type_is_array<U>::value, U>::type* = nullptr>
-	constexpr void
-	array_verif() const noexcept {
-		static_assert(ARR_SIZE > 0, "Array size can't be zero.");
+	void
+	await_resume() const noexcept {
 	}
 
-	template <typename U = T, typename std::enable_if<!dr_type_is_array<U>::value, U>::type* = nullptr>
-	constexpr void
-	array_verif() const noexcept {}
+	unsigned frames;
+};
 
-	void
-	impl_create_dataref() {
-		DATAREFW_ASSERT(dataref_name != "");
-		DATAREFW_ASSERT(dataref_name.find(' ') == std::string::npos);
+template <typename T, typename P>
+class impl_until_awaiter : impl_frame_waiter {
+public:
+	impl_until_awaiter(const impl_dataref_record *r, P p) : record(r), pred(std::move(p)) {}
 
-		verify_types<T>();
-		array_verif();
-		impl_dr_get_datatype();
-		register_dataref_accessor();
+	// A dataref that isn't there, or is of another type, never suspends.
+	bool
+	await_ready() const noexcept {
+		return !impl_frame_readable<T>(record);
 	}
 
 	void
-	impl_dr_cleanup() {
-		if (dataref_loc) {
-			XPLMUnregisterDataAccessor(dataref_loc);
-			dataref_loc = nullptr;
+	await_suspend(FrameTask::handle_type h) {
+		handle = h;
+		h.promise().scheduler->template impl_watch<T>(record, this);
+	}
+
+	std::optional<T>
+	await_resume() {
+		return std::move(value);
+	}
+
+	bool
+	impl_offer(const void *v) override {
+		if (v == nullptr) {
+			return true;
 		}
+		const T& cur = *static_cast<const T *> (v);
+		if (!pred(cur)) {
+			return false;
+		}
+		value = cur;
+		return true;
 	}
+private:
+	const impl_dataref_record *record;
+	P pred;
+	std::optional<T> value;
+};
 
-	std::string dataref_name;
-	XPLMDataRef dataref_loc { nullptr };
-	XPLMDataTypeID dataref_types { xplmType_Unknown };
-	bool dataref_writable { false };
-	T dataref_storage { };
-	static constexpr size_type dataref_storage_max_size = ARRAY_SIZE;
+// until() and read_async() take the wrapper's record as is; path() would
+// assert on one that isn't found.
+struct impl_frame_access {
+	template <typename T, impl_static_path *Path>
+	static const impl_dataref_record *
+	record_of(const FindDataref<T, Path>& dr) noexcept {
+		return dr.record;
+	}
+};
+
+struct impl_any_value {
+	template <typename T>
+	bool
+	operator()(const T&) const noexcept {
+		return true;
+	}
 };
 
+// Resumes on the scheduler's next frame, or after that many frames.
+DATAREFW_NODISCARD inline impl_frame_awaiter
+next_frame(unsigned frames = 1) noexcept {
+	return impl_frame_awaiter { frames };
+}
+
+// Resumes on the first frame, starting with the next one, where pred holds
+// for the dataref's value, and returns that value. Returns an empty optional,
+// without suspending, when the dataref isn't found or is of another type, and
+// on the next frame if it stops being readable while waiting.
+template <typename T, impl_static_path *Path, typename P>
+DATAREFW_NODISCARD impl_until_awaiter<T, P>
+until(const FindDataref<T, Path>& dr, P pred) {
+	return impl_until_awaiter<T, P>(impl_frame_access::record_of(dr), std::move(pred));
+}
+
+// The dataref's value on the next frame, empty on the same failures as
+// until().
+template <typename T, impl_static_path *Path>
+DATAREFW_NODISCARD impl_until_awaiter<T, impl_any_value>
+read_async(const FindDataref<T, Path>& dr) {
+	return impl_until_awaiter<T, impl_any_value>(impl_frame_access::record_of(dr), impl_any_value {});
+}
+
+#endif // DATAREFW_HAS_COROUTINES
+
 } // namespace datarefw
 
 #endif // DATAREFW_H
\ No newline at end of file
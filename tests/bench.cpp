@@ -0,0 +1,1036 @@
+// Copyright (c) 2021 Bennett Anderson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// Per-call cost of the wrapper on the mock XPLM host.
+//
+// Usage: datarefw_bench [--json] [--filter <substr>] [--reps <n>] [--scale <f>]
+//
+// Every benchmark runs --reps times and the median ns/op is reported. --scale
+// multiplies the iteration counts (use something small for smoke runs).
+
+#include <datarefw.hpp>
+
+#include "mock/xplm_mock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace datarefw;
+
+namespace {
+
+constexpr std::size_t BENCH_ARRAY_SIZE = 64;
+
+template <typename T>
+inline void
+do_not_optimize(const T& value) {
+#if (defined(__GNUC__) || defined(__clang__))
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile const void *sink;
+	sink = &value;
+#endif
+}
+
+struct Bench {
+	std::string name;
+	std::uint64_t iterations;
+	std::function<void(std::uint64_t)> run;
+};
+
+struct Result {
+	std::string name;
+	std::uint64_t iterations;
+	double ns_per_op;
+};
+
+struct Options {
+	bool json { false };
+	std::string filter;
+	int reps { 5 };
+	double scale { 1.0 };
+};
+
+Result
+run_bench(const Bench& b, const Options& opt) {
+	const auto iters = std::max<std::uint64_t>(1,
+		static_cast<std::uint64_t> (static_cast<double> (b.iterations) * opt.scale));
+	std::vector<double> samples;
+
+	// Warm-up pass, not recorded.
+	b.run(std::max<std::uint64_t>(1, iters / 10));
+
+	for (int i = 0; i < opt.reps; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		b.run(iters);
+		const auto stop = std::chrono::steady_clock::now();
+		const double ns = static_cast<double> (
+			std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+		samples.push_back(ns / static_cast<double> (iters));
+	}
+
+	std::sort(samples.begin(), samples.end());
+	return Result { b.name, iters, samples[samples.size() / 2] };
+}
+
+// Scalar paths, all of which the sim serves through the same accessor.
+template <typename T>
+void
+add_scalar_benches(std::vector<Bench>& benches, const std::string& type_name,
+	const std::string& path)
+{
+	static FindDataref<T> dr;
+	dr.find_dataref(path);
+
+	benches.push_back({ "find/" + type_name + "/get", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			T v = dr;
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/set", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			dr = static_cast<T> (i & 0xff);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/compound_add", 1000000, [](std::uint64_t n) {
+		dr = T {};
+		for (std::uint64_t i = 0; i < n; ++i) {
+			dr += static_cast<T> (1);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/compare", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			bool b = (dr < static_cast<T> (100));
+			do_not_optimize(b);
+		}
+	}});
+
+	static FindDataref<T> behind;
+	behind.find_dataref(path);
+	behind.write_behind();
+
+	// The same block of updates written through and written behind.
+	benches.push_back({ "find/" + type_name + "/update_block", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			dr = static_cast<T> (1);
+			dr += static_cast<T> (2);
+			dr *= static_cast<T> (3);
+			dr -= static_cast<T> (1);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/update_block_behind", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			behind = static_cast<T> (1);
+			behind += static_cast<T> (2);
+			behind *= static_cast<T> (3);
+			behind -= static_cast<T> (1);
+			flush_writes();
+		}
+	}});
+
+	static FindDataref<T> cached;
+	cached.find_dataref(path);
+	cached.cache_per_frame();
+
+	// 16 reads per frame, about what one instrument does with a dataref.
+	benches.push_back({ "find/" + type_name + "/get_cached", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			if ((i & 15) == 0) {
+				advance_frame();
+			}
+			T v = cached;
+			do_not_optimize(v);
+		}
+	}});
+}
+
+template <typename T>
+void
+add_array_benches(std::vector<Bench>& benches, const std::string& type_name,
+	const std::string& path)
+{
+	static FindDataref<T> dr;
+	dr.find_dataref(path);
+	static T src(BENCH_ARRAY_SIZE);
+
+	benches.push_back({ "find/" + type_name + "/get", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			T v = dr;
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/set", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			dr = src;
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/read_into", 500000, [](std::uint64_t n) {
+		static typename T::value_type buf[BENCH_ARRAY_SIZE];
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto v = dr.read_into(buf, BENCH_ARRAY_SIZE);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/at", 1000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto v = dr.at(i % BENCH_ARRAY_SIZE);
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/size", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto v = dr.size();
+			do_not_optimize(v);
+		}
+	}});
+}
+
+template <typename V>
+void
+add_fixed_array_benches(std::vector<Bench>& benches, const std::string& type_name,
+	const std::string& path)
+{
+	static FindDataref<std::array<V, BENCH_ARRAY_SIZE>> dr;
+	dr.find_dataref(path);
+
+	benches.push_back({ "find/" + type_name + "/get", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto v = dr.get();
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "find/" + type_name + "/at", 1000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto v = dr.at(i % BENCH_ARRAY_SIZE);
+			do_not_optimize(v);
+		}
+	}});
+}
+
+// Walking a large array element by element versus in chunks.
+void
+add_range_benches(std::vector<Bench>& benches) {
+	constexpr std::size_t LARGE_SIZE = 1024;
+	xplm_mock::add_float_array("bench/sim/float_arr_1k", LARGE_SIZE);
+	static FindDataref<DrFloatArr> dr("bench/sim/float_arr_1k");
+
+	benches.push_back({ "find/float_arr_1k/sum_at", 2000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			float sum = 0.0f;
+			for (std::size_t j = 0; j < LARGE_SIZE; ++j) {
+				sum += dr.at(j);
+			}
+			do_not_optimize(sum);
+		}
+	}});
+	benches.push_back({ "find/float_arr_1k/sum_chunked", 2000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			float sum = 0.0f;
+			for (const auto v : dr.chunked()) {
+				sum += v;
+			}
+			do_not_optimize(sum);
+		}
+	}});
+	benches.push_back({ "find/float_arr_1k/read_range_64", 500000, [](std::uint64_t n) {
+		static float buf[64];
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto v = dr.read_range((i * 64) % LARGE_SIZE, 64, buf);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+}
+
+void
+add_string_benches(std::vector<Bench>& benches, const std::string& path) {
+	static FindDataref<std::string> dr;
+	dr.find_dataref(path);
+
+	benches.push_back({ "find/string/get", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			std::string v = dr;
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "find/string/read_into", 500000, [](std::uint64_t n) {
+		static std::string buf;
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto v = dr.read_into(buf);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+	benches.push_back({ "find/string/set", 500000, [](std::uint64_t n) {
+		static const std::string value = "KSEA/16L ILS";
+		for (std::uint64_t i = 0; i < n; ++i) {
+			dr = value;
+		}
+	}});
+}
+
+DATAREFW_PATH(bench_float_path, "bench/sim/float");
+
+void
+add_lookup_benches(std::vector<Bench>& benches) {
+	benches.push_back({ "find/float/find_dataref", 200000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			FindDataref<float> dr("bench/sim/float");
+			do_not_optimize(dr);
+		}
+	}});
+	benches.push_back({ "find/float/static_path", 200000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			FindDataref<float, &bench_float_path::slot> dr;
+			do_not_optimize(dr);
+		}
+	}});
+}
+
+// A frame's worth of scalar polling, individually and through a group.
+void
+add_group_benches(std::vector<Bench>& benches) {
+	constexpr std::size_t GROUP_SIZE = 400;
+	static std::vector<FindDataref<float>> individual;
+	static DatarefGroup group;
+
+	for (std::size_t i = 0; i < GROUP_SIZE; ++i) {
+		const auto path = "bench/group/" + std::to_string(i);
+		xplm_mock::add_float(path, static_cast<float> (i));
+		individual.emplace_back(path);
+		group.add<float>(path);
+	}
+
+	benches.push_back({ "group/float_x400/individual", 5000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			float sum = 0.0f;
+			for (const auto& dr : individual) {
+				sum += dr;
+			}
+			do_not_optimize(sum);
+		}
+	}});
+	benches.push_back({ "group/float_x400/refresh", 5000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			group.refresh();
+			float sum = 0.0f;
+			for (const auto v : group.floats()) {
+				sum += v;
+			}
+			do_not_optimize(sum);
+		}
+	}});
+}
+
+// What a foreign plugin pays to read datarefs we publish.
+void
+add_create_benches(std::vector<Bench>& benches) {
+	static CreateDataref<int> c_int("bench/own/int", true);
+	static CreateDataref<float> c_float("bench/own/float", true);
+	static CreateDataref<double> c_double("bench/own/double", true);
+	static CreateDataref<DrIntArr, BENCH_ARRAY_SIZE> c_int_arr("bench/own/int_arr", true);
+	static CreateDataref<DrFloatArr, BENCH_ARRAY_SIZE> c_float_arr("bench/own/float_arr", true);
+	static CreateDataref<std::string> c_string("bench/own/string", true);
+	static CreateDataref<FixedString<64>> c_fixed("bench/own/fixed_string", true);
+	c_string = "N172SP";
+	c_fixed = "N172SP";
+
+	static const XPLMDataRef r_int = XPLMFindDataRef("bench/own/int");
+	static const XPLMDataRef r_float = XPLMFindDataRef("bench/own/float");
+	static const XPLMDataRef r_double = XPLMFindDataRef("bench/own/double");
+	static const XPLMDataRef r_int_arr = XPLMFindDataRef("bench/own/int_arr");
+	static const XPLMDataRef r_float_arr = XPLMFindDataRef("bench/own/float_arr");
+	static const XPLMDataRef r_string = XPLMFindDataRef("bench/own/string");
+	static const XPLMDataRef r_fixed = XPLMFindDataRef("bench/own/fixed_string");
+
+	benches.push_back({ "create/int/assign", 5000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			c_int = static_cast<int> (i);
+			do_not_optimize(c_int);
+		}
+	}});
+	benches.push_back({ "create/int/foreign_get", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatai(r_int);
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "create/int/foreign_set", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			XPLMSetDatai(r_int, static_cast<int> (i));
+		}
+	}});
+	benches.push_back({ "create/float/foreign_get", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			float v = XPLMGetDataf(r_float);
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "create/double/foreign_get", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			double v = XPLMGetDatad(r_double);
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "create/int_arr/foreign_get", 500000, [](std::uint64_t n) {
+		static int buf[BENCH_ARRAY_SIZE];
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatavi(r_int_arr, buf, 0, BENCH_ARRAY_SIZE);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+	benches.push_back({ "create/float_arr/foreign_get", 500000, [](std::uint64_t n) {
+		static float buf[BENCH_ARRAY_SIZE];
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatavf(r_float_arr, buf, 0, BENCH_ARRAY_SIZE);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+	benches.push_back({ "create/string/foreign_get", 500000, [](std::uint64_t n) {
+		static char buf[64];
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatab(r_string, buf, 0, sizeof(buf) - 1);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+	benches.push_back({ "create/string/foreign_set", 500000, [](std::uint64_t n) {
+		static char msg[] = "KSEA/16L ILS";
+		for (std::uint64_t i = 0; i < n; ++i) {
+			XPLMSetDatab(r_string, msg, 0, sizeof(msg));
+		}
+	}});
+	benches.push_back({ "create/fixed_string/foreign_get", 500000, [](std::uint64_t n) {
+		static char buf[64];
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatab(r_fixed, buf, 0, sizeof(buf) - 1);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+	benches.push_back({ "create/fixed_string/foreign_set", 500000, [](std::uint64_t n) {
+		static char msg[] = "KSEA/16L ILS";
+		for (std::uint64_t i = 0; i < n; ++i) {
+			XPLMSetDatab(r_fixed, msg, 0, sizeof(msg));
+		}
+	}});
+}
+
+// Values handed over from a worker thread. Both sides run on the bench
+// thread here, so this is the uncontended cost of the handoff.
+void
+add_concurrent_benches(std::vector<Bench>& benches) {
+	static ConcurrentCreateDataref<float> c_float("bench/own/concurrent_float");
+	static ConcurrentCreateDataref<DrFloatArr, BENCH_ARRAY_SIZE> c_float_arr(
+		"bench/own/concurrent_float_arr");
+
+	static const XPLMDataRef r_float = XPLMFindDataRef("bench/own/concurrent_float");
+	static const XPLMDataRef r_float_arr = XPLMFindDataRef("bench/own/concurrent_float_arr");
+
+	benches.push_back({ "concurrent/float/publish", 5000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			c_float.publish(static_cast<float> (i));
+		}
+	}});
+	benches.push_back({ "concurrent/float/foreign_get", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			c_float.publish(static_cast<float> (i));
+			float v = XPLMGetDataf(r_float);
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "concurrent/float_arr/publish", 2000000, [](std::uint64_t n) {
+		static std::array<float, BENCH_ARRAY_SIZE> frame {{}};
+		for (std::uint64_t i = 0; i < n; ++i) {
+			frame[0] = static_cast<float> (i);
+			c_float_arr.publish(frame);
+		}
+	}});
+	benches.push_back({ "concurrent/float_arr/foreign_get", 500000, [](std::uint64_t n) {
+		static float buf[BENCH_ARRAY_SIZE];
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatavf(r_float_arr, buf, 0, BENCH_ARRAY_SIZE);
+			do_not_optimize(v);
+			do_not_optimize(buf);
+		}
+	}});
+}
+
+// Foreign writes to an observed dataref, drained every 256 writes.
+void
+add_observer_benches(std::vector<Bench>& benches) {
+	static ChangeQueue queue(1024);
+	static CreateDataref<float> c_float("bench/own/observed_float", true);
+	c_float.observe(&queue, 1);
+	static const XPLMDataRef r_float = XPLMFindDataRef("bench/own/observed_float");
+
+	benches.push_back({ "observed/float/foreign_set", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			XPLMSetDataf(r_float, static_cast<float> (i));
+			if ((i & 255) == 255) {
+				queue.drain([](const DatarefChange& c) { do_not_optimize(c); });
+			}
+		}
+	}});
+}
+
+// Registering and dropping a plugin's worth of datarefs, one wrapper each
+// versus a single table. One iteration is a full start/stop cycle.
+void
+add_registry_benches(std::vector<Bench>& benches) {
+	static const std::size_t count = 512;
+	static std::vector<std::string> paths;
+	static std::vector<DatarefSpec> table;
+	for (std::size_t i = 0; i < count; ++i) {
+		paths.push_back("bench/bulk/dr_" + std::to_string(i));
+	}
+	for (std::size_t i = 0; i < count; ++i) {
+		table.push_back({ paths[i].c_str(), (i & 1) ? xplmType_Float : xplmType_FloatArray, true, 8 });
+	}
+
+	benches.push_back({ "registry/512/create_each", 200, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			std::vector<std::unique_ptr<CreateDataref<float>>> scalars;
+			std::vector<std::unique_ptr<CreateDataref<DrFloatArr, 8>>> arrays;
+			for (std::size_t d = 0; d < count; ++d) {
+				if (d & 1) {
+					scalars.emplace_back(new CreateDataref<float>(paths[d], true));
+				} else {
+					arrays.emplace_back(new CreateDataref<DrFloatArr, 8>(paths[d], true));
+				}
+			}
+			do_not_optimize(scalars);
+		}
+	}});
+	benches.push_back({ "registry/512/register_all", 200, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			DatarefRegistry registry;
+			registry.register_all(table.data(), table.size());
+			do_not_optimize(registry);
+		}
+	}});
+
+	// Paths of its own: registered up front, the same paths would make the
+	// two benches above time failed "already registered" registrations.
+	static std::vector<std::string> get_paths;
+	static std::vector<DatarefSpec> get_table;
+	for (std::size_t i = 0; i < count; ++i) {
+		get_paths.push_back("bench/bulk_get/dr_" + std::to_string(i));
+	}
+	for (std::size_t i = 0; i < count; ++i) {
+		get_table.push_back({ get_paths[i].c_str(), table[i].type, true, 8 });
+	}
+
+	static DatarefRegistry registry;
+	registry.register_all(get_table.data(), get_table.size());
+	static const XPLMDataRef r_float = XPLMFindDataRef(get_paths[1].c_str());
+
+	benches.push_back({ "registry/float/foreign_get", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			float v = XPLMGetDataf(r_float);
+			do_not_optimize(v);
+		}
+	}});
+}
+
+// Requests queued in batches of 256 and run the way the proxy's flight loop
+// would, either all for one dataref (one XPLM read per batch) or spread
+// over 16.
+void
+add_proxy_benches(std::vector<Bench>& benches) {
+	static DatarefProxy proxy;
+	static std::vector<std::string> paths;
+	for (int i = 0; i < 16; ++i) {
+		paths.push_back("bench/sim/proxy_" + std::to_string(i));
+		xplm_mock::add_float(paths.back(), static_cast<float> (i));
+	}
+
+	benches.push_back({ "proxy/float/read_same", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			proxy.read<float>(paths[0], [](float v, bool) { do_not_optimize(v); });
+			if ((i & 255) == 255) {
+				proxy.process();
+			}
+		}
+		proxy.process();
+	}});
+	benches.push_back({ "proxy/float/read_16_paths", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			proxy.read<float>(paths[i & 15], [](float v, bool) { do_not_optimize(v); });
+			if ((i & 255) == 255) {
+				proxy.process();
+			}
+		}
+		proxy.process();
+	}});
+	benches.push_back({ "proxy/float/write", 500000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			proxy.write<float>(paths[i & 15], static_cast<float> (i), [](bool) {});
+			if ((i & 255) == 255) {
+				proxy.process();
+			}
+		}
+		proxy.process();
+	}});
+}
+
+// 300 scalars recorded per frame: written inline from a DatarefGroup, as
+// before, or sampled into the recorder's ring for its thread to write.
+void
+add_recorder_benches(std::vector<Bench>& benches) {
+	struct discard_sink : RecorderSink {
+		void begin(const RecorderLayout&) override {}
+		void write(const unsigned char *frame) override { do_not_optimize(frame); }
+		void end() override {}
+	};
+
+	// The sink outlives the recorder, whose thread stops at exit.
+	static discard_sink sink;
+	static DatarefGroup group;
+	static DatarefRecorder recorder(1024);
+	for (int i = 0; i < 300; ++i) {
+		const std::string path = "bench/sim/rec_" + std::to_string(i);
+		xplm_mock::add_number(path, i);
+		if (i % 3 == 0) {
+			group.add<int>(path);
+			recorder.add<int>(path);
+		} else {
+			group.add<float>(path);
+			recorder.add<float>(path);
+		}
+	}
+	recorder.start(sink);
+
+	benches.push_back({ "recorder/300/inline_fwrite", 20000, [](std::uint64_t n) {
+		std::FILE *f = std::tmpfile();
+		for (std::uint64_t i = 0; i < n; ++i) {
+			group.refresh();
+			std::fwrite(group.ints().data(), sizeof(int), group.ints().size(), f);
+			std::fwrite(group.floats().data(), sizeof(float), group.floats().size(), f);
+		}
+		std::fclose(f);
+	}});
+	benches.push_back({ "recorder/300/sample", 20000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			recorder.sample();
+		}
+	}});
+}
+
+// A 300-float recording, 2000 frames long, written through the file sink on
+// this thread and replayed frame by frame into writable host datarefs.
+void
+add_recording_benches(std::vector<Bench>& benches) {
+	static const char *file_path = "datarefw_bench_recording.drw";
+	static RecorderLayout layout { {}, 0 };
+	for (std::size_t i = 0; i < 300; ++i) {
+		const std::string path = "bench/sim/replay_" + std::to_string(i);
+		xplm_mock::add_float(path);
+		layout.columns.push_back(RecorderColumn { path, xplmType_Float, 16 + i * 4 });
+	}
+	layout.stride = 16 + 300 * 4;
+
+	static std::vector<unsigned char> frame(layout.stride);
+	{
+		RecordingFileSink sink(file_path);
+		sink.begin(layout);
+		for (std::int64_t f = 0; f < 2000; ++f) {
+			const RecordedFrame header { static_cast<std::uint64_t> (f), f * 16667 };
+			std::memcpy(frame.data(), &header, sizeof(header));
+			sink.write(frame.data());
+		}
+		sink.end();
+	}
+
+	static RecordingReader reader(file_path);
+	std::remove(file_path);	// stays mapped
+	static RecordingReplay replay(reader);
+	replay.bind_xplm();
+
+	benches.push_back({ "recording/300/sink_write", 20000, [](std::uint64_t n) {
+		RecordingFileSink sink("/dev/null");
+		sink.begin(layout);
+		for (std::uint64_t i = 0; i < n; ++i) {
+			sink.write(frame.data());
+		}
+		sink.end();
+	}});
+	benches.push_back({ "recording/300/sink_write_xor_delta", 20000, [](std::uint64_t n) {
+		RecordingFileSink sink("/dev/null", 256, RecordingCodec::xor_delta);
+		sink.begin(layout);
+		for (std::uint64_t i = 0; i < n; ++i) {
+			const RecordedFrame header { i, static_cast<std::int64_t> (i) * 16667 };
+			std::memcpy(frame.data(), &header, sizeof(header));
+			sink.write(frame.data());
+		}
+		sink.end();
+	}});
+	benches.push_back({ "recording/300/replay_apply", 20000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			replay.apply(i % reader.frames());
+		}
+	}});
+	benches.push_back({ "recording/frame_at", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			auto f = reader.frame_at(static_cast<std::int64_t> ((i * 7919) % 2000) * 16667);
+			do_not_optimize(f);
+		}
+	}});
+}
+
+// One slowly drifting float per value, the common case in recordings.
+void
+add_codec_benches(std::vector<Bench>& benches) {
+	static std::vector<float> values;
+	for (int i = 0; i < 4096; ++i) {
+		values.push_back(1000.0f + static_cast<float> (i / 8) * 0.25f);
+	}
+	static std::vector<unsigned char> encoded;
+	GorillaEncoder<float> enc(encoded);
+	for (float v : values) {
+		enc.push(v);
+	}
+	enc.finish();
+
+	benches.push_back({ "codec/gorilla_float/encode", 4000000, [](std::uint64_t n) {
+		std::vector<unsigned char> out;
+		out.reserve(values.size() * 4);
+		for (std::uint64_t i = 0; i < n; i += values.size()) {
+			out.clear();
+			GorillaEncoder<float> e(out);
+			const std::size_t count = std::min<std::uint64_t>(values.size(), n - i);
+			for (std::size_t j = 0; j < count; ++j) {
+				e.push(values[j]);
+			}
+			e.finish();
+			do_not_optimize(out);
+		}
+	}});
+	benches.push_back({ "codec/gorilla_float/decode", 4000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; i += values.size()) {
+			GorillaDecoder<float> d(encoded.data(), encoded.size());
+			const std::size_t count = std::min<std::uint64_t>(values.size(), n - i);
+			for (std::size_t j = 0; j < count; ++j) {
+				float v = d.next();
+				do_not_optimize(v);
+			}
+		}
+	}});
+	benches.push_back({ "codec/delta_of_delta/encode", 4000000, [](std::uint64_t n) {
+		std::vector<unsigned char> out;
+		out.reserve(4096 * 2);
+		for (std::uint64_t i = 0; i < n; i += 4096) {
+			out.clear();
+			DeltaOfDeltaEncoder e(out);
+			const std::uint64_t count = std::min<std::uint64_t>(4096, n - i);
+			for (std::uint64_t j = 0; j < count; ++j) {
+				e.push(static_cast<std::int64_t> (j * 16667));
+			}
+			do_not_optimize(out);
+		}
+	}});
+}
+
+// What a timed accessor callback adds on top of the timestamps.
+void
+add_latency_benches(std::vector<Bench>& benches) {
+	benches.push_back({ "latency/histogram_record", 20000000, [](std::uint64_t n) {
+		static LatencyHistogram hist;
+		for (std::uint64_t i = 0; i < n; ++i) {
+			hist.record(20 + (i & 1023));
+		}
+		auto p99 = hist.percentile(0.99);
+		do_not_optimize(p99);
+	}});
+}
+
+// A derived value that costs some trig to compute, read many times a frame.
+void
+add_computed_benches(std::vector<Bench>& benches) {
+	static double lat = 47.44;
+	static ComputedDataref<double> c_dist("bench/own/computed_dist", [] {
+		const double d = std::sin(lat * 0.0174533) * std::sin(47.9 * 0.0174533) +
+			std::cos(lat * 0.0174533) * std::cos(47.9 * 0.0174533) * std::cos(0.01);
+		return std::acos(std::min(1.0, d)) * 3440.065;
+	});
+	static const XPLMDataRef r_dist = XPLMFindDataRef("bench/own/computed_dist");
+
+	benches.push_back({ "computed/double/foreign_get", 2000000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			double v = XPLMGetDatad(r_dist);
+			do_not_optimize(v);
+		}
+	}});
+	benches.push_back({ "computed/double/frame_10_reads", 200000, [](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			// A new sim cycle, without running every bench's flight loops.
+			c_dist.invalidate();
+			lat += 1e-6;
+			for (int r = 0; r < 10; ++r) {
+				double v = XPLMGetDatad(r_dist);
+				do_not_optimize(v);
+			}
+		}
+	}});
+}
+
+// The element-by-element array callbacks CreateDataref had before the bulk
+// copies, registered by hand so the two can be compared. The write keeps the
+// old indexing too (it repeats values[offset]); only its cost matters here.
+struct LegacyFloatArray {
+	std::vector<float> storage;
+	XPLMDataRef loc { nullptr };
+
+	LegacyFloatArray(const std::string& path, std::size_t size) : storage(size) {
+		loc = XPLMRegisterDataAccessor(path.c_str(), xplmType_FloatArray, 1,
+			nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+			nullptr, nullptr, read, write, nullptr, nullptr, this, this);
+	}
+
+	static int
+	read(void *refcon, float *values, int offset, int max) {
+		const auto self = static_cast<LegacyFloatArray *> (refcon);
+		const int a_sz = static_cast<int> (self->storage.size());
+
+		if (values == nullptr) {
+			return a_sz;
+		}
+		if (offset >= a_sz) {
+			return 0;
+		}
+
+		int upper_limit;
+		if ((offset + max) < a_sz) {
+			upper_limit = max;
+		} else {
+			upper_limit = a_sz - offset;
+		}
+
+		for (auto i = 0; i < upper_limit; ++i) {
+			values[i] = self->storage[i + offset];
+		}
+
+		return upper_limit;
+	}
+
+	static void
+	write(void *refcon, float *values, int offset, int count) {
+		const auto self = static_cast<LegacyFloatArray *> (refcon);
+
+		if (values == nullptr) {
+			return;
+		}
+
+		for (auto i = 0; i < count; ++i) {
+			float *value_ptr = values;
+			value_ptr += offset;
+			self->storage[i] = *value_ptr;
+		}
+	}
+};
+
+template <std::size_t N>
+void
+add_create_array_benches(std::vector<Bench>& benches, const std::string& label,
+	std::uint64_t iters) {
+	static CreateDataref<DrFloatArr, N> bulk("bench/own/bulk_" + label, true);
+	static LegacyFloatArray legacy("bench/own/legacy_" + label, N);
+	static std::vector<float> buf(N, 1.0f);
+
+	const XPLMDataRef r_bulk = XPLMFindDataRef(("bench/own/bulk_" + label).c_str());
+	const XPLMDataRef r_legacy = legacy.loc;
+	const int n_elems = static_cast<int> (N);
+
+	benches.push_back({ "create/float_arr_" + label + "/foreign_get_loop", iters,
+		[=](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatavf(r_legacy, buf.data(), 0, n_elems);
+			do_not_optimize(v);
+			do_not_optimize(buf.data());
+		}
+	}});
+	benches.push_back({ "create/float_arr_" + label + "/foreign_get", iters,
+		[=](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatavf(r_bulk, buf.data(), 0, n_elems);
+			do_not_optimize(v);
+			do_not_optimize(buf.data());
+		}
+	}});
+	benches.push_back({ "create/float_arr_" + label + "/foreign_set_loop", iters,
+		[=](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			XPLMSetDatavf(r_legacy, buf.data(), 0, n_elems);
+			do_not_optimize(legacy.storage.data());
+		}
+	}});
+	benches.push_back({ "create/float_arr_" + label + "/foreign_set", iters,
+		[=](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			XPLMSetDatavf(r_bulk, buf.data(), 0, n_elems);
+			do_not_optimize(bulk[0]);
+		}
+	}});
+
+	// Int storage served to a float reader/writer, converted in the callback.
+	static CreateDataref<DrIntArr, N> ints("bench/own/ints_" + label, true);
+	ints.advertise_int_and_float();
+	const XPLMDataRef r_ints = XPLMFindDataRef(("bench/own/ints_" + label).c_str());
+
+	benches.push_back({ "create/int_arr_" + label + "/foreign_get_as_float", iters,
+		[=](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			int v = XPLMGetDatavf(r_ints, buf.data(), 0, n_elems);
+			do_not_optimize(v);
+			do_not_optimize(buf.data());
+		}
+	}});
+	benches.push_back({ "create/int_arr_" + label + "/foreign_set_as_float", iters,
+		[=](std::uint64_t n) {
+		for (std::uint64_t i = 0; i < n; ++i) {
+			XPLMSetDatavf(r_ints, buf.data(), 0, n_elems);
+			do_not_optimize(ints[0]);
+		}
+	}});
+}
+
+std::vector<Bench>
+make_benches() {
+	xplm_mock::add_int("bench/sim/int", 0);
+	xplm_mock::add_float("bench/sim/float", 0.0f);
+	xplm_mock::add_double("bench/sim/double", 0.0);
+	xplm_mock::add_int_array("bench/sim/int_arr", BENCH_ARRAY_SIZE);
+	xplm_mock::add_float_array("bench/sim/float_arr", BENCH_ARRAY_SIZE);
+	xplm_mock::add_data("bench/sim/string", "KSEA/16L ILS");
+
+	std::vector<Bench> benches;
+	add_scalar_benches<int>(benches, "int", "bench/sim/int");
+	add_scalar_benches<float>(benches, "float", "bench/sim/float");
+	add_scalar_benches<double>(benches, "double", "bench/sim/double");
+	add_array_benches<DrIntArr>(benches, "int_arr", "bench/sim/int_arr");
+	add_array_benches<DrFloatArr>(benches, "float_arr", "bench/sim/float_arr");
+	add_fixed_array_benches<int>(benches, "int_array64", "bench/sim/int_arr");
+	add_fixed_array_benches<float>(benches, "float_array64", "bench/sim/float_arr");
+	add_range_benches(benches);
+	add_string_benches(benches, "bench/sim/string");
+	add_lookup_benches(benches);
+	add_group_benches(benches);
+	add_create_benches(benches);
+	add_concurrent_benches(benches);
+	add_computed_benches(benches);
+	add_observer_benches(benches);
+	add_registry_benches(benches);
+	add_proxy_benches(benches);
+	add_recorder_benches(benches);
+	add_recording_benches(benches);
+	add_codec_benches(benches);
+	add_latency_benches(benches);
+	add_create_array_benches<1024>(benches, "1k", 50000);
+	add_create_array_benches<65536>(benches, "64k", 500);
+	return benches;
+}
+
+Options
+parse_args(int argc, char **argv) {
+	Options opt;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = (i + 1 < argc);
+
+		if (arg == "--json") {
+			opt.json = true;
+		} else if (arg == "--filter" && has_value) {
+			opt.filter = argv[++i];
+		} else if (arg == "--reps" && has_value) {
+			opt.reps = std::max(1, std::atoi(argv[++i]));
+		} else if (arg == "--scale" && has_value) {
+			opt.scale = std::atof(argv[++i]);
+		} else {
+			std::fprintf(stderr,
+				"usage: %s [--json] [--filter <substr>] [--reps <n>] [--scale <f>]\n",
+				argv[0]);
+			std::exit(2);
+		}
+	}
+
+	return opt;
+}
+
+void
+print_table(const std::vector<Result>& results) {
+	for (const auto& r : results) {
+		std::printf("%-40s %12.2f ns/op %12llu iters\n", r.name.c_str(),
+			r.ns_per_op, static_cast<unsigned long long> (r.iterations));
+	}
+}
+
+void
+print_json(const std::vector<Result>& results, const Options& opt) {
+	std::printf("{\n  \"reps\": %d,\n  \"scale\": %g,\n  \"benchmarks\": [\n",
+		opt.reps, opt.scale);
+
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		const auto& r = results[i];
+		std::printf("    { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f }%s\n",
+			r.name.c_str(), static_cast<unsigned long long> (r.iterations),
+			r.ns_per_op, (i + 1 < results.size()) ? "," : "");
+	}
+
+	std::printf("  ]\n}\n");
+}
+
+} // namespace
+
+int
+main(int argc, char **argv) {
+	const auto opt = parse_args(argc, argv);
+	const auto benches = make_benches();
+	std::vector<Result> results;
+
+	for (const auto& b : benches) {
+		if (!opt.filter.empty() && b.name.find(opt.filter) == std::string::npos) {
+			continue;
+		}
+		results.push_back(run_bench(b, opt));
+	}
+
+	if (opt.json) {
+		print_json(results, opt);
+	} else {
+		print_table(results);
+	}
+
+	return 0;
+}
@@ -0,0 +1,659 @@
+// Copyright (c) 2021 Bennett Anderson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xplm_mock.hpp"
+
+#include <XPLMProcessing.h>
+#include <XPLMUtilities.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// One slot per dataref name. Slots are never freed, so an XPLMDataRef stays a
+// valid pointer even after its accessor is unregistered (same as in the sim),
+// and objects that outlive a reset() can still unregister safely.
+struct Entry {
+	std::string name;
+	XPLMDataTypeID types { xplmType_Unknown };
+	int writable { 0 };
+	bool registered { false };
+
+	XPLMGetDatai_f read_i { nullptr };
+	XPLMSetDatai_f write_i { nullptr };
+	XPLMGetDataf_f read_f { nullptr };
+	XPLMSetDataf_f write_f { nullptr };
+	XPLMGetDatad_f read_d { nullptr };
+	XPLMSetDatad_f write_d { nullptr };
+	XPLMGetDatavi_f read_vi { nullptr };
+	XPLMSetDatavi_f write_vi { nullptr };
+	XPLMGetDatavf_f read_vf { nullptr };
+	XPLMSetDatavf_f write_vf { nullptr };
+	XPLMGetDatab_f read_b { nullptr };
+	XPLMSetDatab_f write_b { nullptr };
+	void *read_refcon { nullptr };
+	void *write_refcon { nullptr };
+};
+
+// Backing storage for datarefs owned by the mock itself (add_*).
+struct SimValue {
+	double number { 0.0 };
+	std::vector<int> ints;
+	std::vector<float> floats;
+	std::string bytes;
+};
+
+// A callback from XPLMRegisterFlightLoopCallback, due either at a sim time
+// or after a number of frames.
+struct FlightLoop {
+	XPLMFlightLoop_f func { nullptr };
+	void *refcon { nullptr };
+	bool active { false };
+	bool by_cycles { false };
+	bool removed { false };
+	double due_time { 0.0 };
+	int due_cycle { 0 };
+	double last_call { 0.0 };
+};
+
+struct Host {
+	std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+	std::vector<std::unique_ptr<Entry>> retired;
+	std::vector<std::unique_ptr<SimValue>> sim_values;
+	std::vector<std::unique_ptr<FlightLoop>> flight_loops;
+	double elapsed { 0.0 };
+	int cycle { 0 };
+	xplm_mock::Counters counters;
+	std::string debug_output;
+};
+
+// Intentionally leaked, global wrappers may unregister after main() returns.
+Host&
+host() {
+	static Host& h = *new Host;
+	return h;
+}
+
+Entry *
+entry_of(XPLMDataRef ref) {
+	auto e = static_cast<Entry *> (ref);
+	if (e == nullptr || !e->registered) {
+		return nullptr;
+	}
+	return e;
+}
+
+Entry *
+writable_entry_of(XPLMDataRef ref) {
+	auto e = entry_of(ref);
+	if (e == nullptr || !e->writable) {
+		return nullptr;
+	}
+	return e;
+}
+
+Entry *
+slot_for(const char *name) {
+	auto& slot = host().entries[name];
+	if (!slot) {
+		slot.reset(new Entry);
+		slot->name = name;
+	}
+	return slot.get();
+}
+
+FlightLoop *
+flight_loop_of(XPLMFlightLoop_f func, void *refcon) {
+	for (auto& l : host().flight_loops) {
+		if (l->func == func && l->refcon == refcon && !l->removed) {
+			return l.get();
+		}
+	}
+	return nullptr;
+}
+
+// Same meaning as a flight loop's return value: 0 stops the callback, a
+// positive interval is in seconds and a negative one in frames.
+void
+schedule(FlightLoop& l, float interval) {
+	l.active = (interval > 0.0f) || (interval < 0.0f);
+	l.by_cycles = (interval < 0.0f);
+	l.due_time = host().elapsed + interval;
+	l.due_cycle = host().cycle + static_cast<int> (-interval + 0.5f);
+}
+
+SimValue *
+sim_value(void *refcon) {
+	return static_cast<SimValue *> (refcon);
+}
+
+int
+sim_read_i(void *refcon) {
+	return static_cast<int> (sim_value(refcon)->number);
+}
+
+void
+sim_write_i(void *refcon, int value) {
+	sim_value(refcon)->number = value;
+}
+
+float
+sim_read_f(void *refcon) {
+	return static_cast<float> (sim_value(refcon)->number);
+}
+
+void
+sim_write_f(void *refcon, float value) {
+	sim_value(refcon)->number = value;
+}
+
+double
+sim_read_d(void *refcon) {
+	return sim_value(refcon)->number;
+}
+
+void
+sim_write_d(void *refcon, double value) {
+	sim_value(refcon)->number = value;
+}
+
+// Same contract as the sim: a null buffer returns the size, otherwise copy up
+// to max values starting at offset and return how many were copied.
+template <typename U>
+int
+sim_read_arr(const std::vector<U>& storage, U *values, int offset, int max) {
+	const int a_sz = static_cast<int> (storage.size());
+
+	if (values == nullptr) {
+		return a_sz;
+	}
+
+	if (offset < 0 || offset >= a_sz || max <= 0) {
+		return 0;
+	}
+
+	const int n = std::min(max, a_sz - offset);
+	std::memcpy(values, storage.data() + offset, n * sizeof(U));
+	return n;
+}
+
+template <typename U>
+void
+sim_write_arr(std::vector<U>& storage, const U *values, int offset, int count) {
+	const int a_sz = static_cast<int> (storage.size());
+
+	if (values == nullptr || offset < 0 || offset >= a_sz || count <= 0) {
+		return;
+	}
+
+	const int n = std::min(count, a_sz - offset);
+	std::memcpy(storage.data() + offset, values, n * sizeof(U));
+}
+
+int
+sim_read_vi(void *refcon, int *values, int offset, int max) {
+	return sim_read_arr(sim_value(refcon)->ints, values, offset, max);
+}
+
+void
+sim_write_vi(void *refcon, int *values, int offset, int count) {
+	sim_write_arr(sim_value(refcon)->ints, values, offset, count);
+}
+
+int
+sim_read_vf(void *refcon, float *values, int offset, int max) {
+	return sim_read_arr(sim_value(refcon)->floats, values, offset, max);
+}
+
+void
+sim_write_vf(void *refcon, float *values, int offset, int count) {
+	sim_write_arr(sim_value(refcon)->floats, values, offset, count);
+}
+
+int
+sim_read_b(void *refcon, void *values, int offset, int max) {
+	const auto& bytes = sim_value(refcon)->bytes;
+	const int a_sz = static_cast<int> (bytes.size());
+
+	if (values == nullptr) {
+		return a_sz;
+	}
+
+	if (offset < 0 || offset >= a_sz || max <= 0) {
+		return 0;
+	}
+
+	const int n = std::min(max, a_sz - offset);
+	std::memcpy(values, bytes.data() + offset, n);
+	return n;
+}
+
+// Byte datarefs grow to fit, which is what most string datarefs do.
+void
+sim_write_b(void *refcon, void *values, int offset, int count) {
+	auto& bytes = sim_value(refcon)->bytes;
+
+	if (values == nullptr || offset < 0 || count <= 0) {
+		return;
+	}
+
+	bytes.resize(static_cast<std::size_t> (offset + count));
+	std::memcpy(&bytes[offset], values, count);
+}
+
+XPLMDataRef
+add_sim_value(const std::string& path, XPLMDataTypeID types, bool writable,
+	SimValue *value)
+{
+	host().sim_values.emplace_back(value);
+
+	return XPLMRegisterDataAccessor(path.c_str(), types, writable,
+		sim_read_i, sim_write_i,
+		sim_read_f, sim_write_f,
+		sim_read_d, sim_write_d,
+		sim_read_vi, sim_write_vi,
+		sim_read_vf, sim_write_vf,
+		sim_read_b, sim_write_b,
+		value, value);
+}
+
+} // namespace
+
+namespace xplm_mock {
+
+void
+reset() {
+	for (auto& it : host().entries) {
+		const std::string name = it.second->name;
+		*it.second = Entry {};
+		it.second->name = name;
+		host().retired.push_back(std::move(it.second));
+	}
+
+	host().entries.clear();
+	host().sim_values.clear();
+	host().flight_loops.clear();
+	host().elapsed = 0.0;
+	host().cycle = 0;
+	host().counters = Counters {};
+	host().debug_output.clear();
+}
+
+void
+run_frame(float elapsed) {
+	auto& h = host();
+	++h.cycle;
+	h.elapsed += elapsed;
+
+	// Callbacks may register or unregister others; new ones wait a frame.
+	const std::size_t count = h.flight_loops.size();
+	for (std::size_t i = 0; i < count; ++i) {
+		FlightLoop *l = h.flight_loops[i].get();
+		if (!l->active || l->removed) {
+			continue;
+		}
+
+		const bool due = l->by_cycles ? (h.cycle >= l->due_cycle) : (h.elapsed >= l->due_time);
+		if (!due) {
+			continue;
+		}
+
+		const float since = static_cast<float> (h.elapsed - l->last_call);
+		l->last_call = h.elapsed;
+		const float next = l->func(since, elapsed, h.cycle, l->refcon);
+		if (!l->removed) {
+			schedule(*l, next);
+		}
+	}
+
+	h.flight_loops.erase(std::remove_if(h.flight_loops.begin(), h.flight_loops.end(),
+		[](const std::unique_ptr<FlightLoop>& l) { return l->removed; }), h.flight_loops.end());
+}
+
+const Counters&
+counters() noexcept {
+	return host().counters;
+}
+
+void
+reset_counters() noexcept {
+	host().counters = Counters {};
+}
+
+const std::string&
+debug_output() noexcept {
+	return host().debug_output;
+}
+
+XPLMDataRef
+add_int(const std::string& path, int value, bool writable) {
+	auto v = new SimValue;
+	v->number = value;
+	return add_sim_value(path, xplmType_Int, writable, v);
+}
+
+XPLMDataRef
+add_float(const std::string& path, float value, bool writable) {
+	auto v = new SimValue;
+	v->number = value;
+	return add_sim_value(path, xplmType_Float, writable, v);
+}
+
+XPLMDataRef
+add_double(const std::string& path, double value, bool writable) {
+	auto v = new SimValue;
+	v->number = value;
+	return add_sim_value(path, xplmType_Double, writable, v);
+}
+
+XPLMDataRef
+add_number(const std::string& path, double value, bool writable) {
+	auto v = new SimValue;
+	v->number = value;
+	return add_sim_value(path, xplmType_Int | xplmType_Float | xplmType_Double,
+		writable, v);
+}
+
+XPLMDataRef
+add_int_array(const std::string& path, std::size_t size, bool writable) {
+	auto v = new SimValue;
+	v->ints.resize(size);
+	return add_sim_value(path, xplmType_IntArray, writable, v);
+}
+
+XPLMDataRef
+add_float_array(const std::string& path, std::size_t size, bool writable) {
+	auto v = new SimValue;
+	v->floats.resize(size);
+	return add_sim_value(path, xplmType_FloatArray, writable, v);
+}
+
+XPLMDataRef
+add_data(const std::string& path, const std::string& value, bool writable) {
+	auto v = new SimValue;
+	v->bytes = value;
+	return add_sim_value(path, xplmType_Data, writable, v);
+}
+
+} // namespace xplm_mock
+
+XPLMDataRef
+XPLMFindDataRef(const char *inDataRefName) {
+	++host().counters.finds;
+
+	if (inDataRefName == nullptr) {
+		return nullptr;
+	}
+
+	const auto it = host().entries.find(inDataRefName);
+	if (it == host().entries.end() || !it->second->registered) {
+		return nullptr;
+	}
+
+	return it->second.get();
+}
+
+int
+XPLMCanWriteDataRef(XPLMDataRef inDataRef) {
+	return writable_entry_of(inDataRef) != nullptr;
+}
+
+int
+XPLMIsDataRefGood(XPLMDataRef inDataRef) {
+	return entry_of(inDataRef) != nullptr;
+}
+
+XPLMDataTypeID
+XPLMGetDataRefTypes(XPLMDataRef inDataRef) {
+	const auto e = entry_of(inDataRef);
+	return (e != nullptr) ? e->types : xplmType_Unknown;
+}
+
+int
+XPLMGetDatai(XPLMDataRef inDataRef) {
+	++host().counters.gets;
+	const auto e = entry_of(inDataRef);
+	return (e != nullptr && e->read_i) ? e->read_i(e->read_refcon) : 0;
+}
+
+void
+XPLMSetDatai(XPLMDataRef inDataRef, int inValue) {
+	++host().counters.sets;
+	const auto e = writable_entry_of(inDataRef);
+	if (e != nullptr && e->write_i) {
+		e->write_i(e->write_refcon, inValue);
+	}
+}
+
+float
+XPLMGetDataf(XPLMDataRef inDataRef) {
+	++host().counters.gets;
+	const auto e = entry_of(inDataRef);
+	return (e != nullptr && e->read_f) ? e->read_f(e->read_refcon) : 0.0f;
+}
+
+void
+XPLMSetDataf(XPLMDataRef inDataRef, float inValue) {
+	++host().counters.sets;
+	const auto e = writable_entry_of(inDataRef);
+	if (e != nullptr && e->write_f) {
+		e->write_f(e->write_refcon, inValue);
+	}
+}
+
+double
+XPLMGetDatad(XPLMDataRef inDataRef) {
+	++host().counters.gets;
+	const auto e = entry_of(inDataRef);
+	return (e != nullptr && e->read_d) ? e->read_d(e->read_refcon) : 0.0;
+}
+
+void
+XPLMSetDatad(XPLMDataRef inDataRef, double inValue) {
+	++host().counters.sets;
+	const auto e = writable_entry_of(inDataRef);
+	if (e != nullptr && e->write_d) {
+		e->write_d(e->write_refcon, inValue);
+	}
+}
+
+int
+XPLMGetDatavi(XPLMDataRef inDataRef, int *outValues, int inOffset, int inMax) {
+	if (outValues == nullptr) {
+		++host().counters.size_queries;
+	} else {
+		++host().counters.gets;
+	}
+	const auto e = entry_of(inDataRef);
+	return (e != nullptr && e->read_vi) ?
+		e->read_vi(e->read_refcon, outValues, inOffset, inMax) : 0;
+}
+
+void
+XPLMSetDatavi(XPLMDataRef inDataRef, int *inValues, int inoffset, int inCount) {
+	++host().counters.sets;
+	const auto e = writable_entry_of(inDataRef);
+	if (e != nullptr && e->write_vi) {
+		e->write_vi(e->write_refcon, inValues, inoffset, inCount);
+	}
+}
+
+int
+XPLMGetDatavf(XPLMDataRef inDataRef, float *outValues, int inOffset, int inMax) {
+	if (outValues == nullptr) {
+		++host().counters.size_queries;
+	} else {
+		++host().counters.gets;
+	}
+	const auto e = entry_of(inDataRef);
+	return (e != nullptr && e->read_vf) ?
+		e->read_vf(e->read_refcon, outValues, inOffset, inMax) : 0;
+}
+
+void
+XPLMSetDatavf(XPLMDataRef inDataRef, float *inValues, int inoffset, int inCount) {
+	++host().counters.sets;
+	const auto e = writable_entry_of(inDataRef);
+	if (e != nullptr && e->write_vf) {
+		e->write_vf(e->write_refcon, inValues, inoffset, inCount);
+	}
+}
+
+int
+XPLMGetDatab(XPLMDataRef inDataRef, void *outValue, int inOffset, int inMaxBytes) {
+	if (outValue == nullptr) {
+		++host().counters.size_queries;
+	} else {
+		++host().counters.gets;
+	}
+	const auto e = entry_of(inDataRef);
+	return (e != nullptr && e->read_b) ?
+		e->read_b(e->read_refcon, outValue, inOffset, inMaxBytes) : 0;
+}
+
+void
+XPLMSetDatab(XPLMDataRef inDataRef, void *inValue, int inOffset, int inLength) {
+	++host().counters.sets;
+	const auto e = writable_entry_of(inDataRef);
+	if (e != nullptr && e->write_b) {
+		e->write_b(e->write_refcon, inValue, inOffset, inLength);
+	}
+}
+
+XPLMDataRef
+XPLMRegisterDataAccessor(
+	const char *inDataName,
+	XPLMDataTypeID inDataType,
+	int inIsWritable,
+	XPLMGetDatai_f inReadInt,
+	XPLMSetDatai_f inWriteInt,
+	XPLMGetDataf_f inReadFloat,
+	XPLMSetDataf_f inWriteFloat,
+	XPLMGetDatad_f inReadDouble,
+	XPLMSetDatad_f inWriteDouble,
+	XPLMGetDatavi_f inReadIntArray,
+	XPLMSetDatavi_f inWriteIntArray,
+	XPLMGetDatavf_f inReadFloatArray,
+	XPLMSetDatavf_f inWriteFloatArray,
+	XPLMGetDatab_f inReadData,
+	XPLMSetDatab_f inWriteData,
+	void *inReadRefcon,
+	void *inWriteRefcon)
+{
+	if (inDataName == nullptr) {
+		return nullptr;
+	}
+
+	auto e = slot_for(inDataName);
+
+	// The sim refuses to register the same name twice.
+	if (e->registered) {
+		XPLMDebugString("xplm_mock: dataref registered twice\n");
+		return nullptr;
+	}
+
+	e->types = inDataType;
+	e->writable = inIsWritable;
+	e->read_i = inReadInt;
+	e->write_i = inWriteInt;
+	e->read_f = inReadFloat;
+	e->write_f = inWriteFloat;
+	e->read_d = inReadDouble;
+	e->write_d = inWriteDouble;
+	e->read_vi = inReadIntArray;
+	e->write_vi = inWriteIntArray;
+	e->read_vf = inReadFloatArray;
+	e->write_vf = inWriteFloatArray;
+	e->read_b = inReadData;
+	e->write_b = inWriteData;
+	e->read_refcon = inReadRefcon;
+	e->write_refcon = inWriteRefcon;
+	e->registered = true;
+
+	return e;
+}
+
+void
+XPLMUnregisterDataAccessor(XPLMDataRef inDataRef) {
+	auto e = static_cast<Entry *> (inDataRef);
+	if (e == nullptr) {
+		return;
+	}
+
+	const std::string name = e->name;
+	*e = Entry {};
+	e->name = name;
+}
+
+float
+XPLMGetElapsedTime() {
+	return static_cast<float> (host().elapsed);
+}
+
+int
+XPLMGetCycleNumber() {
+	return host().cycle;
+}
+
+void
+XPLMRegisterFlightLoopCallback(XPLMFlightLoop_f inFlightLoop, float inInterval, void *inRefcon) {
+	if (inFlightLoop == nullptr) {
+		return;
+	}
+
+	std::unique_ptr<FlightLoop> l(new FlightLoop);
+	l->func = inFlightLoop;
+	l->refcon = inRefcon;
+	l->last_call = host().elapsed;
+	schedule(*l, inInterval);
+	host().flight_loops.push_back(std::move(l));
+}
+
+void
+XPLMUnregisterFlightLoopCallback(XPLMFlightLoop_f inFlightLoop, void *inRefcon) {
+	// Only flagged, run_frame() may be iterating.
+	auto l = flight_loop_of(inFlightLoop, inRefcon);
+	if (l != nullptr) {
+		l->removed = true;
+	}
+}
+
+void
+XPLMSetFlightLoopCallbackInterval(XPLMFlightLoop_f inFlightLoop, float inInterval,
+	int inRelativeToNow, void *inRefcon)
+{
+	// Always relative to now; the mock doesn't keep the last call's time apart.
+	static_cast<void> (inRelativeToNow);
+	auto l = flight_loop_of(inFlightLoop, inRefcon);
+	if (l != nullptr) {
+		schedule(*l, inInterval);
+	}
+}
+
+void
+XPLMDebugString(const char *inString) {
+	if (inString != nullptr) {
+		host().debug_output += inString;
+	}
+}
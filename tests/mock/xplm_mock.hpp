@@ -0,0 +1,95 @@
+// Copyright (c) 2021 Bennett Anderson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// Local stand-in for the parts of the XPLM that datarefw talks to, so the
+// wrapper can be tested and benchmarked without a running X-Plane.
+//
+// Linking against the mock provides the XPLMDataAccess functions (minus shared
+// data), the XPLMProcessing flight loop callbacks (minus XPLMCreateFlightLoop)
+// and XPLMDebugString. Datarefs either come from CreateDataref /
+// XPLMRegisterDataAccessor like they would in the sim, or are "owned by the
+// sim" through the add_* helpers below, which keep their storage inside the
+// mock. Flight loops only run when a test calls run_frame().
+
+#ifndef DATAREFW_XPLM_MOCK_H
+#define DATAREFW_XPLM_MOCK_H
+
+#include <XPLMDataAccess.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace xplm_mock {
+
+// Number of XPLM calls made since the last reset_counters(). Size queries
+// are the array/byte getters called with a null buffer.
+struct Counters {
+	std::uint64_t finds { 0 };
+	std::uint64_t gets { 0 };
+	std::uint64_t sets { 0 };
+	std::uint64_t size_queries { 0 };
+};
+
+// Unregisters everything (flight loops included), forgets every dataref name
+// and sets the sim clock back to zero.
+void
+reset();
+
+// One frame of the sim: advances the elapsed time and cycle number, then calls
+// every flight loop callback that is due.
+void
+run_frame(float elapsed = 1.0f / 60.0f);
+
+const Counters&
+counters() noexcept;
+
+void
+reset_counters() noexcept;
+
+// Everything passed to XPLMDebugString since the last reset().
+const std::string&
+debug_output() noexcept;
+
+XPLMDataRef
+add_int(const std::string& path, int value = 0, bool writable = true);
+
+XPLMDataRef
+add_float(const std::string& path, float value = 0.0f, bool writable = true);
+
+XPLMDataRef
+add_double(const std::string& path, double value = 0.0, bool writable = true);
+
+// Int | Float | Double, like most of the sim's own scalar datarefs.
+XPLMDataRef
+add_number(const std::string& path, double value = 0.0, bool writable = true);
+
+XPLMDataRef
+add_int_array(const std::string& path, std::size_t size, bool writable = true);
+
+XPLMDataRef
+add_float_array(const std::string& path, std::size_t size, bool writable = true);
+
+XPLMDataRef
+add_data(const std::string& path, const std::string& value = {}, bool writable = true);
+
+} // namespace xplm_mock
+
+#endif // DATAREFW_XPLM_MOCK_H
@@ -0,0 +1,2074 @@
+// Copyright (c) 2021 Bennett Anderson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// Same kind of checks as test.cpp, but against the mock XPLM host so they can
+// run from ctest.
+
+#include <datarefw.hpp>
+
+#include "mock/xplm_mock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <new>
+#include <string>
+#include <thread>
+
+using namespace datarefw;
+
+namespace {
+
+// Atomic, some tests allocate on worker threads.
+std::atomic<std::size_t> alloc_count { 0 };
+
+} // namespace
+
+// Counts every heap allocation in the test binary, see test_read_into().
+void *
+operator new(std::size_t sz) {
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(sz ? sz : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void *
+operator new[](std::size_t sz) {
+	return operator new(sz);
+}
+
+void
+operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void
+operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void
+operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void
+operator delete[](void *p, std::size_t) noexcept {
+	std::free(p);
+}
+#endif // __cpp_sized_deallocation
+
+namespace {
+
+// Handles interned by earlier tests point into the previous mock host.
+void
+reset_host() {
+	xplm_mock::reset();
+	reset_dataref_registry();
+}
+
+void
+test_find_scalar() {
+	reset_host();
+	xplm_mock::add_int("test/sim/int", 0);
+	xplm_mock::add_float("test/sim/float", 1.5f, false);
+	xplm_mock::add_number("test/sim/number", 2.0);
+
+	FindDataref<int> find_int("test/sim/int");
+	FindDataref<float> find_float("test/sim/float");
+	FindDataref<double> find_number("test/sim/number");
+	FindDataref<int> find_missing("test/sim/missing");
+
+	DATAREFW_ASSERT(find_int && find_int.writable());
+	DATAREFW_ASSERT(find_float && !find_float.writable());
+	DATAREFW_ASSERT(find_number.found());
+	DATAREFW_ASSERT(!find_missing);
+
+	int a = 1, b = 2, c = 3;
+
+	find_int = 0;
+	find_int++;
+		DATAREFW_ASSERT(find_int == 1);
+	find_int--;
+		DATAREFW_ASSERT(find_int == 0);
+	find_int += (99 + a + (b - c));
+		DATAREFW_ASSERT(find_int == 99);
+	find_int *= (7 + a);
+		DATAREFW_ASSERT(find_int == 792);
+	find_int /= (4 + b) - c;
+		DATAREFW_ASSERT(find_int == 264);
+	find_int -= 73 - c;
+		DATAREFW_ASSERT(find_int == 194);
+
+	DATAREFW_ASSERT(find_float > 1.0f && find_float < 2.0f);
+	find_number += 0.5;
+	DATAREFW_ASSERT(find_number >= 2.5 && find_number <= 2.5);
+}
+
+void
+test_create_and_find() {
+	reset_host();
+
+	{
+		CreateDataref<int> my_int { "test/own/int", true };
+		CreateDataref<DrIntArr, 25> my_int_array { "test/own/int_array" };
+		CreateDataref<std::string> my_string { "test/own/string", true };
+
+		my_string = "abcdefghijklmnopqrstuvwxyz";
+		DATAREFW_ASSERT(my_string == "abcdefghijklmnopqrstuvwxyz");
+
+		for (std::size_t i = 0; i < my_int_array.size(); ++i) {
+			my_int_array[i] = static_cast<int> (i);
+		}
+
+		FindDataref<int> find_int("test/own/int");
+		FindDataref<DrIntArr> find_int_array("test/own/int_array");
+		FindDataref<std::string> find_string("test/own/string");
+
+		DATAREFW_ASSERT(find_int && find_int.writable());
+		DATAREFW_ASSERT(find_int_array && !find_int_array.writable());
+		DATAREFW_ASSERT(find_string == "abcdefghijklmnopqrstuvwxyz");
+
+		find_int = 42;
+		DATAREFW_ASSERT(my_int == 42);
+
+		DATAREFW_ASSERT(find_int_array.size() == 25);
+		DATAREFW_ASSERT(find_int_array[24] == 24);
+		const DrIntArr all = find_int_array;
+		DATAREFW_ASSERT(all.size() == 25 && all[7] == 7);
+	}
+
+	// Unregistered with the wrappers going out of scope.
+	DATAREFW_ASSERT(XPLMFindDataRef("test/own/int") == nullptr);
+}
+
+void
+test_mock_counters() {
+	reset_host();
+	xplm_mock::add_float_array("test/sim/float_array", 8);
+
+	FindDataref<DrFloatArr> arr("test/sim/float_array");
+	DATAREFW_ASSERT(xplm_mock::counters().finds == 1);
+
+	xplm_mock::reset_counters();
+	auto v = arr.at(3);
+	DATAREFW_UNUSED(v);
+
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 1);
+	DATAREFW_ASSERT(xplm_mock::counters().size_queries == 1);
+}
+
+void
+test_frame_cache() {
+	reset_host();
+	xplm_mock::add_float("test/sim/float", 1.0f);
+	xplm_mock::add_float_array("test/sim/float_array", 4);
+
+	FindDataref<float> f("test/sim/float");
+	FindDataref<DrFloatArr> arr("test/sim/float_array");
+	f.cache_per_frame();
+	arr.cache_per_frame();
+	xplm_mock::reset_counters();
+
+	DATAREFW_ASSERT(f > 0.5f && f < 1.5f);
+	float v = f;
+	DATAREFW_ASSERT(v > 0.5f);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 1);
+
+	// Written value is served back without another read.
+	f = 3.0f;
+	f += 1.0f;
+	DATAREFW_ASSERT(f > 3.5f);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 1);
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 2);
+
+	// Someone else writes mid-frame, we don't see it until the next frame.
+	XPLMSetDataf(XPLMFindDataRef("test/sim/float"), 10.0f);
+	DATAREFW_ASSERT(f < 5.0f);
+	advance_frame();
+	DATAREFW_ASSERT(f > 9.5f);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 2);
+
+	// Whole-array read once, elements and size come from the copy.
+	xplm_mock::reset_counters();
+	for (std::size_t i = 0; i < arr.size(); ++i) {
+		DATAREFW_ASSERT(arr[i] < 1.0f);
+	}
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 1);
+	DATAREFW_ASSERT(xplm_mock::counters().size_queries == 1);
+
+	arr = DrFloatArr { 1.0f, 2.0f, 3.0f, 4.0f };
+	DATAREFW_ASSERT(arr[3] > 3.5f);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 2);
+
+	// The cache is the path's, not the wrapper's: a set through any wrapper
+	// on it, cached or not, is what every cached wrapper reads back.
+	FindDataref<float> g("test/sim/float");
+	FindDataref<float> plain("test/sim/float");
+	g.cache_per_frame();
+	xplm_mock::reset_counters();
+	f = 4.0f;
+	DATAREFW_ASSERT(g > 3.5f && g < 4.5f);
+	plain = 7.0f;
+	DATAREFW_ASSERT(f > 6.5f && g > 6.5f);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 0);
+
+	FindDataref<DrFloatArr> arr2("test/sim/float_array");
+	arr2.cache_per_frame();
+	DATAREFW_ASSERT(arr2[0] > 0.5f && arr2[0] < 1.5f);
+	const std::array<float, 1> first {{ 9.0f }};
+	arr.write_range(0, 1, first.data());
+	DATAREFW_ASSERT(arr2[0] > 8.5f);
+
+	// And so costs the wrappers nothing, whatever T is.
+	DATAREFW_ASSERT(sizeof(FindDataref<DrFloatArr>) == sizeof(FindDataref<float>));
+	DATAREFW_ASSERT(sizeof(FindDataref<std::string>) == sizeof(FindDataref<float>));
+}
+
+void
+test_dataref_group() {
+	reset_host();
+	xplm_mock::add_int("test/sim/int", 7);
+	xplm_mock::add_float("test/sim/float", 1.5f);
+	xplm_mock::add_double("test/sim/double", 2.5);
+	xplm_mock::add_number("test/sim/number", 3.0);
+
+	DatarefGroup grp;
+	const auto i0 = grp.add<int>("test/sim/int");
+	const auto i1 = grp.add<int>("test/sim/number");
+	const auto f0 = grp.add<float>("test/sim/float");
+	const auto f1 = grp.add<float>("test/sim/missing");
+	const auto d0 = grp.add<double>("test/sim/double");
+
+	DATAREFW_ASSERT(grp.size() == 5);
+	DATAREFW_ASSERT(grp.found<float>(f0) && !grp.found<float>(f1));
+	DATAREFW_ASSERT(grp.path<double>(d0) == "test/sim/double");
+
+	xplm_mock::reset_counters();
+	grp.refresh();
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 4);
+
+	DATAREFW_ASSERT(grp.get<int>(i0) == 7 && grp.get<int>(i1) == 3);
+	DATAREFW_ASSERT(grp.get<float>(f0) > 1.0f && grp.get<float>(f1) < 0.5f);
+	DATAREFW_ASSERT(grp.get<double>(d0) > 2.0);
+	DATAREFW_ASSERT(grp.ints().size() == 2 && grp.floats().size() == 2);
+	DATAREFW_ASSERT(grp.doubles().size() == 1);
+
+	XPLMSetDatai(XPLMFindDataRef("test/sim/int"), 8);
+	grp.refresh();
+	DATAREFW_ASSERT(grp.ints()[i0] == 8);
+}
+
+void
+test_read_into() {
+	reset_host();
+	xplm_mock::add_float_array("test/sim/float_array", 64);
+	xplm_mock::add_int_array("test/sim/int_array", 64);
+	xplm_mock::add_data("test/sim/string", "KSEA/16L ILS");
+
+	int src[64];
+	for (int i = 0; i < 64; ++i) {
+		src[i] = i;
+	}
+	XPLMSetDatavi(XPLMFindDataRef("test/sim/int_array"), src, 0, 64);
+
+	FindDataref<DrFloatArr> fa("test/sim/float_array");
+	FindDataref<DrIntArr> ia("test/sim/int_array");
+	FindDataref<std::string> str("test/sim/string");
+
+	float fbuf[64];
+	int ibuf[16];
+	std::string sbuf;
+
+	// First string read sizes the buffer.
+	DATAREFW_ASSERT(str.read_into(sbuf) == 12);
+
+	const std::size_t allocs_before = alloc_count;
+	for (int frame = 0; frame < 1000; ++frame) {
+		DATAREFW_ASSERT(fa.read_into(fbuf, 64) == 64);
+		DATAREFW_ASSERT(ia.read_into(ibuf, 16, 8) == 16);
+		DATAREFW_ASSERT(str.read_into(sbuf) == 12);
+	}
+	DATAREFW_ASSERT(alloc_count == allocs_before);
+
+	DATAREFW_ASSERT(ibuf[0] == 8 && ibuf[15] == 23);
+	DATAREFW_ASSERT(sbuf == "KSEA/16L ILS");
+
+	// Clamped at the end of the dataref.
+	DATAREFW_ASSERT(ia.read_into(ibuf, 16, 60) == 4);
+	DATAREFW_ASSERT(ia.read_into(ibuf, 16, 64) == 0);
+
+	char cbuf[4];
+	DATAREFW_ASSERT(str.read_into(cbuf, 4, 5) == 4);
+	DATAREFW_ASSERT(std::string(cbuf, 4) == "16L ");
+}
+
+void
+test_fixed_array() {
+	reset_host();
+	xplm_mock::add_float_array("test/sim/engines", 8);
+	xplm_mock::add_int_array("test/sim/slots", 24, false);
+
+	FindDataref<std::array<float, 8>> engines("test/sim/engines");
+	FindDataref<std::array<int, 16>> slots("test/sim/slots");
+
+	DATAREFW_ASSERT(engines && engines.writable());
+	DATAREFW_ASSERT(slots && !slots.writable());
+	static_assert(decltype(engines)::size() == 8, "size is compile-time");
+
+	xplm_mock::reset_counters();
+
+	engines = std::array<float, 8> {{ 1, 2, 3, 4, 5, 6, 7, 8 }};
+	engines.set(7, 80.0f);
+	DATAREFW_ASSERT(engines[0] > 0.5f && engines.at(7) > 79.5f);
+
+	float sum = 0.0f;
+	for (const auto v : engines.get()) {
+		sum += v;
+	}
+	DATAREFW_ASSERT(sum > 107.5f && sum < 108.5f);
+
+	float tail[4];
+	DATAREFW_ASSERT(engines.read_into(tail, 8, 4) == 4);
+	DATAREFW_ASSERT(tail[0] > 4.5f);
+
+	// Only the size check in find_dataref ever asked for the size.
+	DATAREFW_ASSERT(xplm_mock::counters().size_queries == 0);
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 2);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 4);
+
+	const std::array<int, 16> s = slots;
+	DATAREFW_ASSERT(s[15] == 0);
+}
+
+void
+test_ranges() {
+	reset_host();
+	xplm_mock::add_float_array("test/sim/float_array", 200);
+
+	FindDataref<DrFloatArr> arr("test/sim/float_array");
+
+	float src[200];
+	for (int i = 0; i < 200; ++i) {
+		src[i] = static_cast<float> (i);
+	}
+
+	xplm_mock::reset_counters();
+	arr.write_range(0, 100, src);
+	arr.write_range(100, 100, src + 100);
+
+	float dst[10];
+	DATAREFW_ASSERT(arr.read_range(150, 10, dst) == 10);
+	DATAREFW_ASSERT(dst[0] > 149.5f && dst[9] < 159.5f);
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 2);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 1);
+	DATAREFW_ASSERT(xplm_mock::counters().size_queries == 0);
+
+	// 200 elements in chunks of 64: one size query and four reads.
+	xplm_mock::reset_counters();
+	float sum = 0.0f;
+	std::size_t n = 0;
+	for (const auto v : arr.chunked()) {
+		sum += v;
+		++n;
+	}
+	DATAREFW_ASSERT(n == 200);
+	DATAREFW_ASSERT(sum > 19899.5f && sum < 19900.5f);
+	DATAREFW_ASSERT(xplm_mock::counters().size_queries == 1);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 4);
+
+	FindDataref<std::array<float, 16>> fixed("test/sim/float_array");
+	fixed.write_range(2, 2, src + 10);
+	DATAREFW_ASSERT(fixed.read_range(2, 4, dst) == 4);
+	DATAREFW_ASSERT(dst[1] > 10.5f && dst[2] > 3.5f && dst[2] < 4.5f);
+}
+
+void
+test_write_behind() {
+	reset_host();
+	xplm_mock::add_int("test/sim/int", 10);
+	xplm_mock::add_double("test/sim/double", 1.0);
+
+	FindDataref<int> i("test/sim/int");
+	FindDataref<double> d("test/sim/double");
+	i.write_behind();
+	d.write_behind();
+	xplm_mock::reset_counters();
+
+	i += 5;
+	i *= 2;
+	++i;
+	i -= 1;
+	DATAREFW_ASSERT(i == 30);
+	d = 0.25;
+	d /= 0.5;
+	DATAREFW_ASSERT(i.write_pending() && d.write_pending());
+
+	// One read to start the += from, nothing written yet.
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 1);
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 0);
+	DATAREFW_ASSERT(XPLMGetDatai(XPLMFindDataRef("test/sim/int")) == 10);
+
+	flush_writes();
+	DATAREFW_ASSERT(!i.write_pending());
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 2);
+	DATAREFW_ASSERT(XPLMGetDatai(XPLMFindDataRef("test/sim/int")) == 30);
+	DATAREFW_ASSERT(XPLMGetDatad(XPLMFindDataRef("test/sim/double")) > 0.49);
+
+	// A copy that goes away doesn't lose its write.
+	{
+		FindDataref<int> tmp = i;
+		tmp = 99;
+	}
+	flush_writes();
+	DATAREFW_ASSERT(i == 99);
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 3);
+
+	// Nothing pending, nothing sent.
+	flush_writes();
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 3);
+
+	// Two wrappers on one dataref share its entry: one set, last write wins.
+	FindDataref<int> other("test/sim/int");
+	other.write_behind();
+	i = 1;
+	other = 2;
+	i = 3;
+	DATAREFW_ASSERT(other.write_pending() && other == 3);
+	flush_writes();
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 4);
+	DATAREFW_ASSERT(XPLMGetDatai(XPLMFindDataRef("test/sim/int")) == 3);
+
+	// A direct set through a plain wrapper drops what was queued: it reads
+	// back its own value, and the flush doesn't overwrite it.
+	FindDataref<int> plain("test/sim/int");
+	i = 6;
+	plain = 9;
+	DATAREFW_ASSERT(!i.write_pending() && plain == 9 && i == 9);
+	flush_writes();
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 5);
+	DATAREFW_ASSERT(XPLMGetDatai(XPLMFindDataRef("test/sim/int")) == 9);
+
+	// Read-only datarefs aren't queued, so reads never show a value the sim
+	// won't take.
+	xplm_mock::add_int("test/sim/locked", 4, false);
+	FindDataref<int> locked("test/sim/locked");
+	locked.write_behind();
+	locked = 8;
+	DATAREFW_ASSERT(!locked.write_pending() && locked == 4);
+	flush_writes();
+	DATAREFW_ASSERT(xplm_mock::counters().sets == 5 && locked == 4);
+}
+
+void
+test_create_string_callbacks() {
+	reset_host();
+
+	CreateDataref<std::string> str("test/own/string", true);
+	CreateDataref<FixedString<8>> fixed("test/own/fixed", true);
+	str.reserve(64);
+	str = "hello world";
+
+	const auto str_ref = XPLMFindDataRef("test/own/string");
+	const auto fixed_ref = XPLMFindDataRef("test/own/fixed");
+
+	// Reader with no room for a terminator doesn't get one written past max.
+	char buf[8];
+	buf[5] = '#';
+	DATAREFW_ASSERT(XPLMGetDatab(str_ref, buf, 0, 5) == 5);
+	DATAREFW_ASSERT(buf[5] == '#');
+	DATAREFW_ASSERT(XPLMGetDatab(str_ref, buf, 6, 8) == 5);
+	DATAREFW_ASSERT(std::string(buf) == "world");
+
+	char msg[] = "XY";
+	XPLMSetDatab(str_ref, msg, 6, sizeof(msg));
+	DATAREFW_ASSERT(str == "hello XY");
+
+	char longer[] = "KSEA/16L ILS";
+	char back[32];
+	const std::size_t allocs_before = alloc_count;
+	for (int frame = 0; frame < 1000; ++frame) {
+		XPLMSetDatab(str_ref, longer, 0, sizeof(longer));
+		DATAREFW_ASSERT(XPLMGetDatab(str_ref, back, 0, sizeof(back)) == 12);
+		XPLMSetDatab(fixed_ref, longer, 0, sizeof(longer));
+		DATAREFW_ASSERT(XPLMGetDatab(fixed_ref, back, 0, sizeof(back)) == 8);
+	}
+	DATAREFW_ASSERT(alloc_count == allocs_before);
+
+	// Clamped to the inline capacity.
+	DATAREFW_ASSERT(fixed == "KSEA/16L");
+	fixed = "N1";
+	fixed += "72SP-long";
+	DATAREFW_ASSERT(fixed == "N172SP-l");
+	const FixedString<8> copy = fixed;
+	DATAREFW_ASSERT(copy.str() == "N172SP-l" && copy.size() == 8);
+
+	FindDataref<std::string> find_fixed("test/own/fixed");
+	DATAREFW_ASSERT(find_fixed == "N172SP-l");
+}
+
+void
+test_create_array_callbacks() {
+	reset_host();
+
+	CreateDataref<DrFloatArr, 16> arr("test/own/float_array", true);
+	for (std::size_t i = 0; i < arr.size(); ++i) {
+		arr[i] = static_cast<float> (i);
+	}
+
+	const auto ref = XPLMFindDataRef("test/own/float_array");
+
+	// Bulk write lands at the offset, element by element, clamped to the end.
+	float src[8] = { 100.0f, 101.0f, 102.0f, 103.0f, 104.0f, 105.0f, 106.0f, 107.0f };
+	XPLMSetDatavf(ref, src, 12, 8);
+	DATAREFW_ASSERT(arr[11] < 11.5f);
+	DATAREFW_ASSERT(arr[12] > 99.5f && arr[13] > 100.5f && arr[15] > 102.5f);
+
+	XPLMSetDatavf(ref, src, 16, 8);
+	XPLMSetDatavf(ref, src, 3, 0);
+	DATAREFW_ASSERT(arr[3] < 3.5f);
+
+	float dst[8];
+	DATAREFW_ASSERT(XPLMGetDatavf(ref, nullptr, 0, 0) == 16);
+	DATAREFW_ASSERT(XPLMGetDatavf(ref, dst, 10, 8) == 6);
+	DATAREFW_ASSERT(dst[0] > 9.5f && dst[0] < 10.5f && dst[5] > 102.5f);
+	DATAREFW_ASSERT(XPLMGetDatavf(ref, dst, 16, 8) == 0);
+	DATAREFW_ASSERT(XPLMGetDatavf(ref, dst, 0, 0) == 0);
+
+	// Same storage served to an int reader, converted.
+	int idst[4];
+	DATAREFW_ASSERT(XPLMGetDatavi(ref, idst, 12, 4) == 4);
+	DATAREFW_ASSERT(idst[0] == 100 && idst[3] == 103);
+}
+
+void
+test_create_cross_type_arrays() {
+	reset_host();
+
+	// Odd size so the vector kernels and the scalar tail both run.
+	CreateDataref<DrIntArr, 19> ints("test/own/ints", true);
+	const auto ref = XPLMFindDataRef("test/own/ints");
+	DATAREFW_ASSERT(XPLMGetDataRefTypes(ref) == xplmType_IntArray);
+
+	ints.advertise_int_and_float();
+	const auto both = XPLMFindDataRef("test/own/ints");
+	DATAREFW_ASSERT(XPLMGetDataRefTypes(both) == (xplmType_IntArray | xplmType_FloatArray));
+
+	for (std::size_t i = 0; i < ints.size(); ++i) {
+		ints[i] = static_cast<int> (i) - 9;
+	}
+
+	FindDataref<DrFloatArr> as_floats("test/own/ints");
+	DATAREFW_ASSERT(as_floats.found() && as_floats.size() == 19);
+	float fdst[19];
+	DATAREFW_ASSERT(as_floats.read_into(fdst, 19) == 19);
+	for (int i = 0; i < 19; ++i) {
+		DATAREFW_ASSERT(fdst[i] > static_cast<float> (i - 9) - 0.5f);
+		DATAREFW_ASSERT(fdst[i] < static_cast<float> (i - 9) + 0.5f);
+	}
+
+	// Floats written into the int storage truncate toward zero.
+	float src[19];
+	for (int i = 0; i < 19; ++i) {
+		src[i] = (i % 2) ? -2.7f : 2.7f;
+	}
+	XPLMSetDatavf(both, src, 0, 19);
+	DATAREFW_ASSERT(ints[0] == 2 && ints[1] == -2 && ints[17] == -2 && ints[18] == 2);
+
+	FindDataref<DrIntArr> as_ints("test/own/ints");
+	DATAREFW_ASSERT(as_ints.found() && as_ints[18] == 2);
+}
+
+void
+test_create_array_storage() {
+	reset_host();
+
+	// Fixed sizes live inside the object, no heap storage of their own.
+	CreateDataref<DrFloatArr, 32> fixed("test/own/fixed_array", true);
+	const auto obj = reinterpret_cast<const char *> (&fixed);
+	const auto first = reinterpret_cast<const char *> (&fixed[0]);
+	DATAREFW_ASSERT(first >= obj && first + 32 * sizeof(float) <= obj + sizeof(fixed));
+	DATAREFW_ASSERT(fixed.size() == 32 && fixed.max_size() == 32);
+
+	const DrFloatArr assigned = (fixed = DrFloatArr { 1.0f, 2.0f, 3.0f });
+	DATAREFW_ASSERT(assigned.size() == 32 && assigned[2] > 2.5f);
+	DATAREFW_ASSERT(fixed[2] > 2.5f && fixed[3] < 0.5f);
+	const DrFloatArr copy = fixed;
+	DATAREFW_ASSERT(copy.size() == 32 && copy[1] > 1.5f);
+	DATAREFW_ASSERT((fixed != DrFloatArr { 1.0f, 2.0f, 3.0f }));
+
+	// Runtime-sized arrays start empty and are resized by the owner.
+	CreateDataref<DrIntArr, dynamic_array_size> dynamic("test/own/dynamic_array", true);
+	const auto ref = XPLMFindDataRef("test/own/dynamic_array");
+	DATAREFW_ASSERT(dynamic.size() == 0 && XPLMGetDatavi(ref, nullptr, 0, 0) == 0);
+
+	dynamic.reserve(64);
+	dynamic.resize(40);
+	dynamic[39] = 7;
+	DATAREFW_ASSERT(XPLMGetDatavi(ref, nullptr, 0, 0) == 40);
+	FindDataref<DrIntArr> find_dynamic("test/own/dynamic_array");
+	DATAREFW_ASSERT(find_dynamic[39] == 7);
+
+	dynamic = DrIntArr { 4, 5 };
+	DATAREFW_ASSERT(dynamic.size() == 2 && dynamic == (DrIntArr { 4, 5 }));
+	DATAREFW_ASSERT(find_dynamic.size() == 2);
+}
+
+void
+test_concurrent_create() {
+	reset_host();
+
+	constexpr int N = 256;
+	constexpr int PUBLISHES = 20000;
+
+	ConcurrentCreateDataref<DrFloatArr, N> arr("test/own/concurrent_array");
+	ConcurrentCreateDataref<int> counter("test/own/concurrent_int");
+	const auto arr_ref = XPLMFindDataRef("test/own/concurrent_array");
+	const auto counter_ref = XPLMFindDataRef("test/own/concurrent_int");
+	DATAREFW_ASSERT(arr_ref != nullptr && !XPLMCanWriteDataRef(arr_ref));
+
+	std::thread worker([&] {
+		std::array<float, N> frame;
+		for (int k = 1; k <= PUBLISHES; ++k) {
+			frame.fill(static_cast<float> (k));
+			arr.publish(frame);
+			counter.publish(k);
+		}
+	});
+
+	// Every snapshot the sim side reads is one whole publish, never a mix.
+	float dst[N];
+	float last = 0.0f;
+	int last_count = 0;
+	for (;;) {
+		DATAREFW_ASSERT(XPLMGetDatavf(arr_ref, dst, 0, N) == N);
+		for (int i = 1; i < N; ++i) {
+			DATAREFW_ASSERT(!(dst[i] < dst[0]) && !(dst[i] > dst[0]));
+		}
+		DATAREFW_ASSERT(!(dst[0] < last));
+		last = dst[0];
+
+		const int count = XPLMGetDatai(counter_ref);
+		DATAREFW_ASSERT(count >= last_count);
+		last_count = count;
+
+		if (count == PUBLISHES && !(last < static_cast<float> (PUBLISHES))) {
+			break;
+		}
+	}
+	worker.join();
+
+	// update() starts from the last published value.
+	arr.update([](std::array<float, N>& values) {
+		values[3] = -1.0f;
+	});
+	DATAREFW_ASSERT(arr.latest()[3] < 0.0f && arr.latest()[4] > 1.0f);
+
+	ConcurrentCreateDataref<FixedString<16>> callsign("test/own/concurrent_callsign");
+	callsign.publish("N172SP");
+	FindDataref<std::string> find_callsign("test/own/concurrent_callsign");
+	DATAREFW_ASSERT(find_callsign == "N172SP");
+}
+
+void
+test_computed() {
+	reset_host();
+
+	int evaluations = 0;
+	ComputedDataref<float> dist("test/own/computed_dist", [&evaluations] {
+		++evaluations;
+		return 12.5f * static_cast<float> (evaluations);
+	});
+	ComputedDataref<DrIntArr, 4> gear("test/own/computed_gear", [] {
+		return std::array<int, 4> {{ 1, 1, 0, 1 }};
+	});
+	int gear_evaluations = 0;
+	ComputedDataref<DrIntArr, 4> unread("test/own/computed_unread", [&gear_evaluations] {
+		++gear_evaluations;
+		return std::array<int, 4> {{}};
+	});
+
+	// Nobody has read it, nothing was computed.
+	DATAREFW_ASSERT(evaluations == 0);
+
+	FindDataref<float> find_dist("test/own/computed_dist");
+	DATAREFW_ASSERT(find_dist.found() && !find_dist.writable());
+	for (int i = 0; i < 10; ++i) {
+		DATAREFW_ASSERT(find_dist > 12.0f && find_dist < 13.0f);
+	}
+	DATAREFW_ASSERT(evaluations == 1);
+
+	// The frame cache's clock has nothing to do with it...
+	advance_frame();
+	DATAREFW_ASSERT(find_dist < 13.0f && evaluations == 1);
+
+	// ...the sim's cycle does.
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(XPLMGetDatad(XPLMFindDataRef("test/own/computed_dist")) > 24.0);
+	DATAREFW_ASSERT(find_dist > 24.0f);
+	DATAREFW_ASSERT(evaluations == 2);
+
+	dist.invalidate();
+	DATAREFW_ASSERT(dist.get() > 37.0f && evaluations == 3);
+
+	FindDataref<std::array<int, 4>> find_gear("test/own/computed_gear");
+	DATAREFW_ASSERT(find_gear[1] == 1 && find_gear[2] == 0);
+
+	// Size queries on fixed-size arrays don't compute anything.
+	FindDataref<DrIntArr> find_unread("test/own/computed_unread");
+	DATAREFW_ASSERT(find_unread.size() == 4 && gear_evaluations == 0);
+}
+
+void
+test_change_queue() {
+	reset_host();
+
+	ChangeQueue queue(1024);
+	CreateDataref<float> flaps("test/own/flaps", true);
+	CreateDataref<DrIntArr, 8> lights("test/own/lights", true);
+	CreateDataref<std::string> atc("test/own/atc", true);
+	CreateDataref<int> ignored("test/own/ignored", true);
+	flaps.observe(&queue, 1);
+	lights.observe(&queue, 2);
+	atc.observe(&queue, 3);
+
+	const auto flaps_ref = XPLMFindDataRef("test/own/flaps");
+	const auto lights_ref = XPLMFindDataRef("test/own/lights");
+
+	XPLMSetDataf(flaps_ref, 0.5f);
+	int on[3] = { 1, 1, 1 };
+	XPLMSetDatavi(lights_ref, on, 6, 3);
+	char msg[] = "CLEARED";
+	XPLMSetDatab(XPLMFindDataRef("test/own/atc"), msg, 0, sizeof(msg));
+	XPLMSetDatai(XPLMFindDataRef("test/own/ignored"), 3);
+	// The owner's own writes aren't reported.
+	flaps = 0.75f;
+
+	DatarefChange c;
+	DATAREFW_ASSERT(queue.try_pop(c) && c.id == 1 && c.type == xplmType_Float);
+	DATAREFW_ASSERT(c.value > 0.49 && c.value < 0.51 && c.count == 0);
+	const auto first_ts = c.timestamp;
+	DATAREFW_ASSERT(queue.try_pop(c) && c.id == 2 && c.type == xplmType_IntArray);
+	DATAREFW_ASSERT(c.offset == 6 && c.count == 2);	// clamped to the array
+	DATAREFW_ASSERT(c.timestamp >= first_ts);
+	DATAREFW_ASSERT(queue.try_pop(c) && c.id == 3 && c.type == xplmType_Data);
+	DATAREFW_ASSERT(c.offset == 0 && c.count == 7);
+	DATAREFW_ASSERT(!queue.try_pop(c));
+
+	// A full queue drops and counts instead of blocking the writer.
+	ChangeQueue small(4);
+	flaps.observe(&small, 1);
+	for (int i = 0; i < 10; ++i) {
+		XPLMSetDataf(flaps_ref, static_cast<float> (i));
+	}
+	DATAREFW_ASSERT(small.dropped() == 6);
+	DATAREFW_ASSERT(small.drain([](const DatarefChange&) {}) == 4);
+
+	// Sim thread writing while two workers drain: nothing lost or repeated.
+	constexpr int WRITES = 50000;
+	flaps.observe(&queue, 1);
+	std::atomic<int> drained { 0 };
+	std::atomic<bool> done { false };
+	std::atomic<long long> sum { 0 };
+	auto consumer = [&] {
+		DatarefChange change;
+		for (;;) {
+			if (queue.try_pop(change)) {
+				sum += static_cast<long long> (change.value);
+				++drained;
+			} else if (done) {
+				if (!queue.try_pop(change)) {
+					break;
+				}
+				sum += static_cast<long long> (change.value);
+				++drained;
+			}
+		}
+	};
+	std::thread worker_a(consumer);
+	std::thread worker_b(consumer);
+	long long expected = 0;
+	for (int i = 0; i < WRITES; ++i) {
+		XPLMSetDataf(flaps_ref, static_cast<float> (i % 1000));
+		expected += i % 1000;
+	}
+	done = true;
+	worker_a.join();
+	worker_b.join();
+
+	DATAREFW_ASSERT(static_cast<std::uint64_t> (drained) + queue.dropped() == WRITES);
+	if (queue.dropped() == 0) {
+		DATAREFW_ASSERT(sum == expected);
+	}
+
+	flaps.observe(nullptr);
+}
+
+void
+test_versions() {
+	reset_host();
+
+	CreateDataref<float> flaps("test/own/flaps", true);
+	CreateDataref<DrFloatArr, 1000> grid("test/own/grid", true);
+	CreateDataref<std::string> atc("test/own/atc", true);
+	DATAREFW_ASSERT(flaps.version() == 0 && grid.dirty_range().empty());
+
+	flaps = 0.5f;
+	flaps += 0.25f;
+	++flaps;
+	XPLMSetDataf(XPLMFindDataRef("test/own/flaps"), 0.1f);
+	DATAREFW_ASSERT(flaps.version() == 4);
+
+	atc = "CLEARED";
+	char msg[] = "HOLD";
+	XPLMSetDatab(XPLMFindDataRef("test/own/atc"), msg, 0, sizeof(msg));
+	DATAREFW_ASSERT(atc.version() == 2);
+
+	// Ranges from both sides merge until acknowledged.
+	const auto grid_ref = XPLMFindDataRef("test/own/grid");
+	float slice[10] = {};
+	XPLMSetDatavf(grid_ref, slice, 500, 10);
+	grid[20] = 1.0f;
+	auto dirty = grid.dirty_range();
+	DATAREFW_ASSERT(dirty.begin == 20 && dirty.end == 510 && dirty.size() == 490);
+	DATAREFW_ASSERT(grid.version() == 2);
+
+	grid.acknowledge();
+	DATAREFW_ASSERT(grid.dirty_range().empty() && grid.version() == 2);
+
+	// Clamped at the end of the array.
+	XPLMSetDatavf(grid_ref, slice, 995, 10);
+	dirty = grid.dirty_range();
+	DATAREFW_ASSERT(dirty.begin == 995 && dirty.end == 1000);
+
+	// Reads don't count.
+	float back[10];
+	DATAREFW_ASSERT(XPLMGetDatavf(grid_ref, back, 0, 10) == 10);
+	DATAREFW_ASSERT(grid.version() == 3);
+
+	// Nor do our own, through a const wrapper.
+	grid.acknowledge();
+	const auto& grid_view = grid;
+	DATAREFW_ASSERT(grid_view[20] > 0.5f && grid_view.at(21) < 0.5f);
+	DATAREFW_ASSERT(grid.dirty_range().empty() && grid.version() == 3);
+
+	grid.acknowledge();
+	grid = DrFloatArr { 1.0f, 2.0f };
+	DATAREFW_ASSERT(grid.dirty_range().begin == 0 && grid.dirty_range().end == 2);
+}
+
+void
+test_bulk_registry() {
+	reset_host();
+
+	static const DatarefSpec table[] = {
+		{ "test/bulk/gear", xplmType_Int, true, 0 },
+		{ "test/bulk/ias", xplmType_Float, false, 0 },
+		{ "test/bulk/lat", xplmType_Double, true, 0 },
+		{ "test/bulk/n1", xplmType_FloatArray, true, 4 },
+		{ "test/bulk/doors", xplmType_IntArray, false, 3 },
+		{ "test/bulk/atc", xplmType_Data, true, 8 },
+	};
+
+	{
+		DatarefRegistry registry(table);
+		DATAREFW_ASSERT(registry.size() == 6);
+		DATAREFW_ASSERT(std::strcmp(registry.path(3), "test/bulk/n1") == 0);
+		DATAREFW_ASSERT(registry.index_of("test/bulk/atc") == 5);
+		DATAREFW_ASSERT(registry.index_of("test/bulk/none") == registry.size());
+
+		registry.value<int>(0) = 1;
+		registry.value<float>(1) = 120.5f;
+		registry.array<float>(3)[2] = 97.0f;
+		registry.array<int>(4)[1] = 1;
+		registry.assign(5, "CLEARED TO LAND", 15);
+
+		const auto gear = XPLMFindDataRef("test/bulk/gear");
+		const auto ias = XPLMFindDataRef("test/bulk/ias");
+		const auto lat = XPLMFindDataRef("test/bulk/lat");
+		DATAREFW_ASSERT(XPLMGetDatai(gear) == 1);
+		DATAREFW_ASSERT(XPLMGetDatad(ias) > 120.4 && XPLMGetDatad(ias) < 120.6);
+		DATAREFW_ASSERT(XPLMCanWriteDataRef(gear) && !XPLMCanWriteDataRef(ias));
+
+		// Foreign writes land in the block, converted to the row's type.
+		XPLMSetDataf(lat, 47.5f);
+		XPLMSetDatai(gear, 0);
+		DATAREFW_ASSERT(registry.value<double>(2) > 47.4 && registry.value<double>(2) < 47.6);
+		DATAREFW_ASSERT(registry.value<int>(0) == 0);
+
+		const auto n1 = XPLMFindDataRef("test/bulk/n1");
+		DATAREFW_ASSERT(XPLMGetDatavf(n1, nullptr, 0, 0) == 4);
+		int n1_as_int[4] = {};
+		DATAREFW_ASSERT(XPLMGetDatavi(n1, n1_as_int, 0, 8) == 4);
+		DATAREFW_ASSERT(n1_as_int[2] == 97);
+		float spool[] = { 50.0f, 51.0f, 52.0f };
+		XPLMSetDatavf(n1, spool, 2, 3);
+		DATAREFW_ASSERT(registry.array<float>(3)[3] > 50.9f && registry.array_size(3) == 4);
+
+		int doors[3] = {};
+		DATAREFW_ASSERT(XPLMGetDatavi(XPLMFindDataRef("test/bulk/doors"), doors, 0, 3) == 3);
+		DATAREFW_ASSERT(doors[0] == 0 && doors[1] == 1);
+
+		// Byte rows are clamped to their capacity.
+		DATAREFW_ASSERT(registry.str(5) == "CLEARED ");
+		const auto atc = XPLMFindDataRef("test/bulk/atc");
+		char msg[] = "HOLD";
+		XPLMSetDatab(atc, msg, 0, sizeof(msg));
+		DATAREFW_ASSERT(registry.str(5) == "HOLD");
+		DATAREFW_ASSERT(XPLMGetDatab(atc, nullptr, 0, 0) == 4);
+
+		registry.unregister_all();
+		DATAREFW_ASSERT(registry.size() == 0);
+		DATAREFW_ASSERT(XPLMGetDatai(gear) == 0);
+
+		// A cleared registry can take a new table.
+		registry.register_all(table, 2);
+		DATAREFW_ASSERT(registry.size() == 2);
+	}
+
+	// The destructor unregisters what is left.
+	DATAREFW_ASSERT(XPLMGetDatai(XPLMFindDataRef("test/bulk/gear")) == 0);
+}
+
+// Keeps frames in memory; write() can be held back to fill the ring.
+struct memory_sink : RecorderSink {
+	void
+	begin(const RecorderLayout& l) override {
+		layout = l;
+	}
+
+	void
+	write(const unsigned char *frame) override {
+		while (held.load()) {
+			std::this_thread::yield();
+		}
+		frames.emplace_back(frame, frame + layout.stride);
+	}
+
+	void
+	end() override {
+		ended = true;
+	}
+
+	RecorderLayout layout { {}, 0 };
+	std::vector<std::vector<unsigned char>> frames;
+	std::atomic<bool> held { false };
+	bool ended { false };
+};
+
+template <typename T>
+T
+frame_value(const std::vector<unsigned char>& frame, std::size_t offset) {
+	T value;
+	std::memcpy(&value, frame.data() + offset, sizeof(T));
+	return value;
+}
+
+void
+test_frame_ring() {
+	FrameRing ring(4, 12);
+	DATAREFW_ASSERT(ring.front() == nullptr && ring.capacity() == 4);
+
+	unsigned char rec[12] = {};
+	for (unsigned char i = 0; i < 6; ++i) {
+		rec[11] = i;
+		ring.try_push(rec);
+	}
+	DATAREFW_ASSERT(ring.dropped() == 2);
+
+	for (unsigned char i = 0; i < 4; ++i) {
+		DATAREFW_ASSERT(ring.front() != nullptr && ring.front()[11] == i);
+		ring.pop();
+	}
+	DATAREFW_ASSERT(ring.front() == nullptr);
+}
+
+void
+test_recorder() {
+	reset_host();
+	const auto gear = xplm_mock::add_int("test/sim/gear", 1);
+	const auto ias = xplm_mock::add_float("test/sim/ias", 100.0f);
+	xplm_mock::add_double("test/sim/lat", 47.5);
+
+	memory_sink sink;
+	{
+		DatarefRecorder recorder(4);
+		const auto i_ias = recorder.add<float>("test/sim/ias");
+		const auto i_gear = recorder.add<int>("test/sim/gear");
+		const auto i_lat = recorder.add<double>("test/sim/lat");
+		const auto i_none = recorder.add<float>("test/sim/missing");
+		DATAREFW_ASSERT(i_ias == 0 && i_gear == 0 && i_lat == 0 && i_none == 1);
+
+		// Hold the writer so the ring fills: 4 frames fit, 6 are dropped.
+		sink.held = true;
+		recorder.start(sink);
+		const auto& layout = recorder.layout();
+		DATAREFW_ASSERT(layout.columns.size() == 4 && layout.stride % 8 == 0);
+		DATAREFW_ASSERT(layout.columns[0].path == "test/sim/lat" && layout.columns[0].offset == 16);
+
+		for (int f = 0; f < 10; ++f) {
+			xplm_mock::run_frame(0.5f);
+			XPLMSetDataf(ias, 100.0f + static_cast<float> (f));
+			XPLMSetDatai(gear, f);
+			recorder.sample();
+		}
+		DATAREFW_ASSERT(recorder.get<int>(i_gear) == 9 && recorder.get<float>(i_none) < 0.1f);
+		DATAREFW_ASSERT(recorder.sampled() == 10 && recorder.dropped() == 6);
+
+		sink.held = false;
+		recorder.stop();
+	}
+
+	DATAREFW_ASSERT(sink.ended && sink.frames.size() == 4);
+	std::size_t ias_offset = 0;
+	std::size_t gear_offset = 0;
+	for (const auto& c : sink.layout.columns) {
+		if (c.path == "test/sim/ias") {
+			ias_offset = c.offset;
+		} else if (c.path == "test/sim/gear") {
+			gear_offset = c.offset;
+		}
+	}
+
+	for (std::size_t f = 0; f < sink.frames.size(); ++f) {
+		const auto header = frame_value<RecordedFrame>(sink.frames[f], 0);
+		DATAREFW_ASSERT(header.sequence == f);
+		DATAREFW_ASSERT(header.time_us == static_cast<std::int64_t> (f + 1) * 500000);
+		DATAREFW_ASSERT(frame_value<int>(sink.frames[f], gear_offset) == static_cast<int> (f));
+		DATAREFW_ASSERT(frame_value<float>(sink.frames[f], ias_offset) > 99.0f + static_cast<float> (f));
+	}
+
+	// Paths registered after add() are sampled: before start() through its
+	// lookup, later once anything finds them. A registry reset drops them
+	// back to zero until they are looked up again.
+	{
+		memory_sink late_sink;
+		DatarefRecorder recorder(16);
+		const auto i_early = recorder.add<float>("test/sim/rec_early");
+		const auto i_late = recorder.add<int>("test/sim/rec_late");
+		xplm_mock::add_float("test/sim/rec_early", 5.0f);
+		recorder.start(late_sink);
+		recorder.sample();
+		DATAREFW_ASSERT(recorder.get<float>(i_early) > 4.9f && recorder.get<int>(i_late) == 0);
+
+		xplm_mock::add_int("test/sim/rec_late", 7);
+		FindDataref<int> finder("test/sim/rec_late");
+		recorder.sample();
+		DATAREFW_ASSERT(recorder.get<int>(i_late) == 7);
+
+		reset_dataref_registry();
+		recorder.sample();
+		DATAREFW_ASSERT(recorder.get<int>(i_late) == 0 && recorder.get<float>(i_early) < 0.1f);
+		finder.find_dataref("test/sim/rec_late");
+		recorder.sample();
+		DATAREFW_ASSERT(recorder.get<int>(i_late) == 7);
+		recorder.stop();
+	}
+
+	// The raw file sink writes the frames unchanged.
+	const char *file_path = "datarefw_recorder_test.bin";
+	{
+		RawFrameFileSink file(file_path);
+		DATAREFW_ASSERT(file.is_open());
+		DatarefRecorder recorder(64);
+		recorder.add<float>("test/sim/ias");
+		recorder.start(file);
+		for (int f = 0; f < 20; ++f) {
+			recorder.sample();
+		}
+		recorder.stop();
+		DATAREFW_ASSERT(recorder.dropped() == 0 && recorder.layout().stride == 24);
+	}
+	std::FILE *f = std::fopen(file_path, "rb");
+	DATAREFW_ASSERT(f != nullptr);
+	std::fseek(f, 0, SEEK_END);
+	DATAREFW_ASSERT(std::ftell(f) == 20 * 24);
+	std::fclose(f);
+	std::remove(file_path);
+}
+
+// Writes bytes to file_path with the value at `at` replaced.
+template <typename V>
+void
+write_patched(const char *file_path, std::vector<char> bytes, std::size_t at, V value) {
+	std::memcpy(bytes.data() + at, &value, sizeof(value));
+	std::FILE *f = std::fopen(file_path, "wb");
+	DATAREFW_ASSERT(f != nullptr);
+	std::fwrite(bytes.data(), 1, bytes.size(), f);
+	std::fclose(f);
+}
+
+// Records 10 frames of ias/gear/lat, 4 frames per block, into file_path.
+void
+write_test_recording(const char *file_path) {
+	reset_host();
+	const auto gear = xplm_mock::add_int("test/sim/gear", 0);
+	const auto ias = xplm_mock::add_float("test/sim/ias", 0.0f);
+	const auto lat = xplm_mock::add_double("test/sim/lat", 0.0);
+
+	RecordingFileSink sink(file_path, 4);
+	DATAREFW_ASSERT(sink.is_open());
+	DatarefRecorder recorder(16);
+	recorder.add<float>("test/sim/ias");
+	recorder.add<int>("test/sim/gear");
+	recorder.add<double>("test/sim/lat");
+	recorder.start(sink);
+
+	for (int f = 0; f < 10; ++f) {
+		xplm_mock::run_frame(0.25f);
+		XPLMSetDatai(gear, f);
+		XPLMSetDataf(ias, 100.0f + static_cast<float> (f));
+		XPLMSetDatad(lat, 47.0 + f * 0.5);
+		recorder.sample();
+	}
+	recorder.stop();
+}
+
+void
+test_recording_file() {
+	const char *file_path = "datarefw_recording_test.drw";
+	write_test_recording(file_path);
+
+	{
+		RecordingReader reader(file_path);
+		DATAREFW_ASSERT(reader.is_open() && reader.frames() == 10 && reader.columns() == 3);
+		const auto c_gear = reader.column_of("test/sim/gear");
+		const auto c_ias = reader.column_of("test/sim/ias");
+		DATAREFW_ASSERT(reader.type(c_gear) == xplmType_Int && reader.path(c_ias) == "test/sim/ias");
+		DATAREFW_ASSERT(reader.column_of("test/sim/none") == reader.columns());
+
+		for (std::uint64_t f = 0; f < reader.frames(); ++f) {
+			DATAREFW_ASSERT(reader.sequence(f) == f);
+			DATAREFW_ASSERT(reader.time_us(f) == static_cast<std::int64_t> (f + 1) * 250000);
+			DATAREFW_ASSERT(reader.value<int>(c_gear, f) == static_cast<int> (f));
+			DATAREFW_ASSERT(reader.value<int>(c_ias, f) == 100 + static_cast<int> (f));
+		}
+		const double lat9 = reader.value<double>(reader.column_of("test/sim/lat"), 9);
+		DATAREFW_ASSERT(lat9 > 51.49 && lat9 < 51.51);
+
+		// Seek index, then within the block.
+		DATAREFW_ASSERT(reader.frame_at(0) == 0);
+		DATAREFW_ASSERT(reader.frame_at(1250000) == 4);
+		DATAREFW_ASSERT(reader.frame_at(1400000) == 4);
+		DATAREFW_ASSERT(reader.frame_at(2499999) == 8);
+		DATAREFW_ASSERT(reader.frame_at(99000000) == 9);
+	}
+
+	// Without the index and trailer, complete blocks still read.
+	std::FILE *f = std::fopen(file_path, "rb");
+	DATAREFW_ASSERT(f != nullptr);
+	std::vector<char> bytes(1 << 16);
+	bytes.resize(std::fread(bytes.data(), 1, bytes.size(), f));
+	std::fclose(f);
+	RecordingFileHeader header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	const char *cut_path = "datarefw_recording_cut.drw";
+	f = std::fopen(cut_path, "wb");
+	std::fwrite(bytes.data(), 1, header.data_offset + 2 * header.block_bytes + 100, f);
+	std::fclose(f);
+	{
+		RecordingReader cut(cut_path);
+		DATAREFW_ASSERT(cut.is_open() && cut.frames() == 8);
+		DATAREFW_ASSERT(cut.frame_at(99000000) == 7);
+	}
+
+	// A trailer or index that disagrees with the blocks is ignored, and the
+	// blocks are walked instead.
+	const std::size_t trailer_at = bytes.size() - sizeof(RecordingFileTrailer);
+	RecordingFileTrailer trailer;
+	std::memcpy(&trailer, bytes.data() + trailer_at, sizeof(trailer));
+	write_patched(cut_path, bytes, trailer_at + offsetof(RecordingFileTrailer, frame_count),
+		std::uint64_t { 1000 });
+	{
+		RecordingReader bad(cut_path);
+		DATAREFW_ASSERT(bad.is_open() && bad.frames() == 10);
+		DATAREFW_ASSERT(bad.value<int>(bad.column_of("test/sim/gear"), 9) == 9);
+	}
+	write_patched(cut_path, bytes, static_cast<std::size_t> (trailer.index_offset) +
+		sizeof(RecordingIndexEntry) + offsetof(RecordingIndexEntry, offset),
+		std::uint64_t { 1 } << 40);
+	{
+		RecordingReader bad(cut_path);
+		DATAREFW_ASSERT(bad.is_open() && bad.frames() == 10);
+		DATAREFW_ASSERT(bad.frame_at(1400000) == 4);
+	}
+	write_patched(cut_path, bytes, trailer_at + offsetof(RecordingFileTrailer, index_offset),
+		trailer.index_offset - header.block_bytes);
+	{
+		RecordingReader bad(cut_path);
+		DATAREFW_ASSERT(bad.is_open() && bad.frames() == 10);
+	}
+	std::remove(cut_path);
+
+	DATAREFW_ASSERT(!RecordingReader("datarefw_no_such_file.drw").is_open());
+	std::remove(file_path);
+}
+
+void
+test_recording_replay() {
+	const char *file_path = "datarefw_replay_test.drw";
+	write_test_recording(file_path);
+
+	// Onto the host's own datarefs...
+	reset_host();
+	const auto gear = xplm_mock::add_int("test/sim/gear", -1);
+	const auto ias = xplm_mock::add_float("test/sim/ias", 0.0f, false);
+	{
+		RecordingReader reader(file_path);
+		RecordingReplay replay(reader);
+		DATAREFW_ASSERT(replay.bind_xplm() == 1);
+
+		DATAREFW_ASSERT(replay.advance(0.0) && XPLMGetDatai(gear) == 0);
+		DATAREFW_ASSERT(replay.advance(0.5) && XPLMGetDatai(gear) == 2);
+		replay.set_speed(4.0);
+		DATAREFW_ASSERT(replay.advance(0.25) && XPLMGetDatai(gear) == 6);
+		DATAREFW_ASSERT(!replay.advance(1.0) && XPLMGetDatai(gear) == 9);
+		DATAREFW_ASSERT(XPLMGetDataf(ias) < 0.1f);
+
+		replay.rewind();
+		replay.advance(0.0);
+		DATAREFW_ASSERT(replay.frame() == 0 && XPLMGetDatai(gear) == 0);
+
+		// Targets registered after binding are replayed once resolved, and
+		// ones that don't take the recorded type never are.
+		const auto lat = xplm_mock::add_double("test/sim/lat", 0.0);
+		DATAREFW_ASSERT(replay.resolve() == 2);
+		replay.apply(9);
+		DATAREFW_ASSERT(XPLMGetDatad(lat) > 51.49 && XPLMGetDatad(lat) < 51.51);
+
+		// After a registry reset nothing is written until looked up again.
+		reset_dataref_registry();
+		replay.apply(3);
+		DATAREFW_ASSERT(XPLMGetDatai(gear) == 9);
+		DATAREFW_ASSERT(replay.resolve() == 2);
+		replay.apply(3);
+		DATAREFW_ASSERT(XPLMGetDatai(gear) == 3);
+	}
+	{
+		reset_host();
+		const auto gear_as_float = xplm_mock::add_float("test/sim/gear", -1.0f);
+		RecordingReader reader(file_path);
+		RecordingReplay replay(reader);
+		DATAREFW_ASSERT(replay.bind_xplm() == 0);
+		replay.apply(5);
+		DATAREFW_ASSERT(XPLMGetDataf(gear_as_float) < -0.9f);
+	}
+
+	// ...or straight into CreateDatarefs, under any path.
+	{
+		CreateDataref<float> replay_ias("test/own/replay_ias");
+		CreateDataref<int> replay_gear("test/own/replay_gear");
+		CreateDataref<double> gear_as_double("test/own/gear_as_double");
+		RecordingReader reader(file_path);
+		RecordingReplay replay(reader);
+		DATAREFW_ASSERT(replay.bind("test/sim/ias", replay_ias));
+		DATAREFW_ASSERT(replay.bind("test/sim/gear", replay_gear));
+		DATAREFW_ASSERT(!replay.bind("test/sim/none", replay_ias));
+		// Recorded as int, so not cast into a double.
+		DATAREFW_ASSERT(!replay.bind("test/sim/gear", gear_as_double));
+
+		replay.apply(7);
+		DATAREFW_ASSERT(replay_ias > 106.9f && replay_ias < 107.1f);
+		DATAREFW_ASSERT(replay_gear == 7);
+	}
+	std::remove(file_path);
+}
+
+template <typename F>
+void
+check_gorilla_round_trip(const std::vector<F>& values) {
+	std::vector<unsigned char> bytes;
+	GorillaEncoder<F> enc(bytes);
+	for (F v : values) {
+		enc.push(v);
+	}
+	enc.finish();
+
+	GorillaDecoder<F> dec(bytes.data(), bytes.size());
+	for (F v : values) {
+		const F back = dec.next();
+		DATAREFW_ASSERT(std::memcmp(&back, &v, sizeof(F)) == 0);
+	}
+}
+
+void
+test_codecs() {
+	// Bit-exact, specials included.
+	std::vector<float> floats { 1.0f, 1.0f, 1.0f, 1.5f, -0.0f, 0.0f, 3.4e38f,
+		std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(),
+		1e-40f, 97.25f };
+	std::vector<double> doubles { 47.5, 47.5, 47.500001, -1e300, 0.0, 5e-324,
+		std::numeric_limits<double>::quiet_NaN(), 47.500002 };
+	for (int i = 0; i < 1000; ++i) {
+		floats.push_back(100.0f + static_cast<float> (i % 37) * 0.01f);
+		doubles.push_back(47.0 + i * 1e-6);
+	}
+	check_gorilla_round_trip(floats);
+	check_gorilla_round_trip(doubles);
+	check_gorilla_round_trip(std::vector<float> { 2.0f });
+
+	// A steady value costs about a bit per frame.
+	std::vector<unsigned char> bytes;
+	GorillaEncoder<float> steady(bytes);
+	for (int i = 0; i < 800; ++i) {
+		steady.push(120.5f);
+	}
+	steady.finish();
+	DATAREFW_ASSERT(bytes.size() == 4 + 100);
+
+	const std::vector<std::int64_t> ints { 0, 16667, 33334, 50001, 66668, -5,
+		std::numeric_limits<std::int64_t>::max(), std::numeric_limits<std::int64_t>::min(), 7 };
+	bytes.clear();
+	DeltaOfDeltaEncoder dod(bytes);
+	for (auto v : ints) {
+		dod.push(v);
+	}
+	DeltaOfDeltaDecoder undod(bytes.data(), bytes.size());
+	for (auto v : ints) {
+		DATAREFW_ASSERT(undod.next() == v);
+	}
+
+	// A frame clock costs a byte per frame after the first two.
+	bytes.clear();
+	DeltaOfDeltaEncoder clock(bytes);
+	for (std::int64_t t = 0; t < 1000; ++t) {
+		clock.push(1000000 + t * 16667);
+	}
+	DATAREFW_ASSERT(bytes.size() == 3 + 3 + 998);
+}
+
+void
+test_compressed_recording() {
+	reset_host();
+	const char *file_path = "datarefw_compressed_test.drw";
+	const char *raw_path = "datarefw_uncompressed_test.drw";
+
+	// 300 datarefs like a real session: most hold still, some drift slowly.
+	std::vector<XPLMDataRef> refs;
+	for (int i = 0; i < 300; ++i) {
+		refs.push_back(xplm_mock::add_float("test/sim/f" + std::to_string(i), static_cast<float> (i)));
+	}
+	const auto gear = xplm_mock::add_int("test/sim/gear", 0);
+	const auto lat = xplm_mock::add_double("test/sim/lat", 47.0);
+
+	{
+		RecordingFileSink sink(file_path, 128, RecordingCodec::xor_delta);
+		RecordingFileSink raw(raw_path, 128);
+		DatarefRecorder recorder(1024);
+		DatarefRecorder raw_recorder(1024);
+		for (int i = 0; i < 300; ++i) {
+			recorder.add<float>("test/sim/f" + std::to_string(i));
+			raw_recorder.add<float>("test/sim/f" + std::to_string(i));
+		}
+		recorder.add<int>("test/sim/gear");
+		recorder.add<double>("test/sim/lat");
+		raw_recorder.add<int>("test/sim/gear");
+		raw_recorder.add<double>("test/sim/lat");
+		recorder.start(sink);
+		raw_recorder.start(raw);
+
+		for (int f = 0; f < 1000; ++f) {
+			xplm_mock::run_frame();
+			for (int i = 0; i < 30; ++i) {
+				XPLMSetDataf(refs[i * 10], static_cast<float> (i) + static_cast<float> (f) * 0.125f);
+			}
+			XPLMSetDatai(gear, f / 100);
+			XPLMSetDatad(lat, 47.0 + f * 1e-5);
+			recorder.sample();
+			raw_recorder.sample();
+		}
+		recorder.stop();
+		raw_recorder.stop();
+		DATAREFW_ASSERT(recorder.dropped() == 0 && raw_recorder.dropped() == 0);
+	}
+
+	std::FILE *f = std::fopen(file_path, "rb");
+	std::fseek(f, 0, SEEK_END);
+	const long compressed_size = std::ftell(f);
+	std::fclose(f);
+	f = std::fopen(raw_path, "rb");
+	std::fseek(f, 0, SEEK_END);
+	const long raw_size = std::ftell(f);
+	std::fclose(f);
+	DATAREFW_ASSERT(compressed_size * 5 < raw_size);
+
+	{
+		RecordingReader packed(file_path);
+		RecordingReader plain(raw_path);
+		DATAREFW_ASSERT(packed.is_open() && packed.frames() == 1000 && plain.frames() == 1000);
+		for (std::uint64_t fr = 0; fr < 1000; fr += 7) {
+			DATAREFW_ASSERT(packed.time_us(fr) == plain.time_us(fr) && packed.sequence(fr) == fr);
+			for (std::size_t c = 0; c < packed.columns(); ++c) {
+				DATAREFW_ASSERT(std::memcmp(packed.raw(c, fr), plain.raw(c, fr),
+					impl_recording_width(packed.type(c))) == 0);
+			}
+		}
+		DATAREFW_ASSERT(packed.frame_at(plain.time_us(555)) == 555);
+	}
+
+	std::vector<char> bytes(static_cast<std::size_t> (compressed_size));
+	f = std::fopen(file_path, "rb");
+	bytes.resize(std::fread(bytes.data(), 1, bytes.size(), f));
+	std::fclose(f);
+
+	// A block claiming to run past the end of the file isn't decoded.
+	RecordingFileHeader header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	write_patched(file_path, bytes, static_cast<std::size_t> (header.data_offset) +
+		offsetof(RecordingBlockHeader, bytes), std::uint32_t { 0xffffff00u });
+	{
+		RecordingReader bad(file_path);
+		DATAREFW_ASSERT(bad.is_open() && bad.frames() == 0);
+	}
+
+	// Cut mid-block: the complete compressed blocks still read.
+	f = std::fopen(file_path, "wb");
+	std::fwrite(bytes.data(), 1, bytes.size() / 2, f);
+	std::fclose(f);
+	{
+		RecordingReader cut(file_path);
+		DATAREFW_ASSERT(cut.is_open() && cut.frames() > 0 && cut.frames() < 1000);
+		DATAREFW_ASSERT(cut.frames() % 128 == 0);
+		DATAREFW_ASSERT(cut.value<int>(cut.column_of("test/sim/gear"), cut.frames() - 1) ==
+			static_cast<int> ((cut.frames() - 1) / 100));
+	}
+
+	std::remove(file_path);
+	std::remove(raw_path);
+}
+
+void
+test_proxy() {
+	reset_host();
+	xplm_mock::add_float("test/sim/ias", 120.0f);
+	xplm_mock::add_int("test/sim/gear", 0);
+	const auto n1_ref = xplm_mock::add_float_array("test/sim/n1", 4);
+	float n1[] = { 10.0f, 20.0f, 30.0f, 40.0f };
+	XPLMSetDatavf(n1_ref, n1, 0, 4);
+
+	DatarefProxy proxy;
+
+	// Many threads asking for the same value in one frame cost one read.
+	std::vector<std::future<float>> speeds(64);
+	std::atomic<int> n1_sum { 0 };
+	std::vector<std::thread> workers;
+	for (int t = 0; t < 4; ++t) {
+		workers.emplace_back([&proxy, &speeds, &n1_sum, t] {
+			for (int i = 0; i < 16; ++i) {
+				speeds[t * 16 + i] = proxy.read<float>("test/sim/ias");
+			}
+			proxy.read<DrFloatArr>("test/sim/n1", [&n1_sum](DrFloatArr&& v, bool found) {
+				DATAREFW_ASSERT(found);
+				n1_sum += static_cast<int> (v[0] + v[1] + v[2] + v[3]);
+			});
+		});
+	}
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	DATAREFW_ASSERT(speeds[0].wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+	xplm_mock::reset_counters();
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 2);
+	for (auto& s : speeds) {
+		const float v = s.get();
+		DATAREFW_ASSERT(v > 119.9f && v < 120.1f);
+	}
+	DATAREFW_ASSERT(n1_sum == 400);
+
+	// A write splits the reads around it, in queue order.
+	std::thread writer([&proxy] {
+		auto before = proxy.read<int>("test/sim/gear");
+		auto set = proxy.write<int>("test/sim/gear", 1);
+		auto after = proxy.read<int>("test/sim/gear");
+		auto again = proxy.read<int>("test/sim/gear");
+		set.wait();
+		DATAREFW_ASSERT(before.get() == 0 && after.get() == 1 && again.get() == 1);
+	});
+	while (XPLMGetDatai(XPLMFindDataRef("test/sim/gear")) == 0) {
+		xplm_mock::reset_counters();
+		xplm_mock::run_frame();
+		std::this_thread::yield();
+	}
+	writer.join();
+
+	// Missing, mistyped and read-only targets fail the request instead of
+	// asserting on the sim thread, and never reach the sim.
+	xplm_mock::add_int("test/sim/locked", 7, false);
+	int failed = 0;
+	proxy.read<float>("test/sim/misspelled", [&failed](float, bool found) {
+		failed += !found;
+	});
+	proxy.read<float>("test/sim/gear", [&failed](float, bool found) {
+		failed += !found;
+	});
+	proxy.write<int>("test/sim/locked", 1, [&failed](bool found) {
+		failed += !found;
+	});
+	proxy.read<int>("test/sim/locked", [](int v, bool found) {
+		DATAREFW_ASSERT(found && v == 7);
+	});
+	auto missing = proxy.read<int>("test/sim/misspelled");
+	// Paths the registry would assert on fail the same way.
+	proxy.read<int>("", [&failed](int, bool found) {
+		failed += !found;
+	});
+	proxy.write<int>("test/sim/has space", 1, [&failed](bool found) {
+		failed += !found;
+	});
+	xplm_mock::reset_counters();
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(failed == 5);
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 1 && xplm_mock::counters().sets == 0);
+	bool broken = false;
+	try {
+		(void) missing.get();
+	} catch (const std::future_error& e) {
+		broken = (e.code() == std::future_errc::broken_promise);
+	}
+	DATAREFW_ASSERT(broken);
+
+	// Nothing queued, nothing called.
+	xplm_mock::reset_counters();
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 0 && xplm_mock::counters().finds == 0);
+
+	// Running a batch doesn't allocate once the proxy is warm.
+	float ias_sum = 0.0f;
+	int gear_sum = 0;
+	for (int i = 0; i < 4; ++i) {
+		proxy.read<float>("test/sim/ias", [&ias_sum](float v, bool) {
+			ias_sum += v;
+		});
+		proxy.read<int>("test/sim/gear", [&gear_sum](int v, bool) {
+			gear_sum += v;
+		});
+	}
+	const std::size_t allocs_before = alloc_count;
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(alloc_count == allocs_before);
+	DATAREFW_ASSERT(ias_sum > 479.0f && gear_sum == 4);
+
+	// Leftovers run when the proxy goes away.
+	std::future<void> last;
+	{
+		DatarefProxy late;
+		last = late.write<float>("test/sim/ias", 80.0f);
+	}
+	last.get();
+	DATAREFW_ASSERT(XPLMGetDataf(XPLMFindDataRef("test/sim/ias")) < 80.1f);
+	xplm_mock::run_frame();
+}
+
+#ifdef DATAREFW_HAS_COROUTINES
+struct coro_trace {
+	int gear_seen { -1 };
+	int steps { 0 };
+	bool destroyed { false };
+	bool failed { false };
+};
+
+// Sets destroyed when the coroutine frame holding it goes away.
+struct frame_guard {
+	~frame_guard() {
+		trace->destroyed = true;
+	}
+
+	coro_trace *trace;
+};
+
+FrameTask
+coro_gear_sequence(FindDataref<int>& gear, FindDataref<float>& flaps, coro_trace& trace) {
+	trace.gear_seen = *co_await until(gear, [](int g) { return g == 1; });
+	flaps = 0.5f;
+	++trace.steps;
+	co_await next_frame(3);
+	flaps = 1.0f;
+	++trace.steps;
+}
+
+FrameTask
+coro_watch_gear(FindDataref<int>& gear, coro_trace& trace) {
+	frame_guard guard { &trace };
+	trace.gear_seen = *co_await read_async(gear);
+	++trace.steps;
+	co_await until(gear, [](int g) { return g == 2; });
+	++trace.steps;
+}
+
+template <typename T>
+FrameTask
+coro_wait_for(FindDataref<T>& dr, coro_trace& trace) {
+	const auto v = co_await until(dr, [](const T&) { return false; });
+	trace.failed = !v.has_value();
+	++trace.steps;
+}
+
+FrameTask
+coro_wait_n1(FindDataref<DrFloatArr>& n1, coro_trace& trace) {
+	const auto v = co_await until(n1, [](const DrFloatArr& a) { return a[1] > 50.0f; });
+	trace.gear_seen = static_cast<int> ((*v)[1]);
+	++trace.steps;
+}
+
+void
+test_coroutines() {
+	reset_host();
+	xplm_mock::add_int("test/sim/gear", 0);
+	xplm_mock::add_float("test/sim/flaps", 0.0f);
+	FindDataref<int> gear("test/sim/gear");
+	FindDataref<float> flaps("test/sim/flaps");
+
+	coro_trace seq;
+	coro_trace watch_a;
+	coro_trace watch_b;
+	{
+		FrameScheduler scheduler;
+		scheduler.spawn(coro_gear_sequence(gear, flaps, seq));
+		scheduler.spawn(coro_watch_gear(gear, watch_a));
+		scheduler.spawn(coro_watch_gear(gear, watch_b));
+		DATAREFW_ASSERT(scheduler.waiting() == 3 && seq.steps == 0);
+
+		// Three tasks on one dataref, one read.
+		xplm_mock::reset_counters();
+		xplm_mock::run_frame();
+		DATAREFW_ASSERT(xplm_mock::counters().gets == 1);
+		DATAREFW_ASSERT(watch_a.steps == 1 && watch_a.gear_seen == 0 && watch_b.steps == 1);
+		DATAREFW_ASSERT(seq.steps == 0 && scheduler.waiting() == 3);
+
+		gear = 1;
+		xplm_mock::run_frame();
+		DATAREFW_ASSERT(seq.steps == 1 && seq.gear_seen == 1);
+		DATAREFW_ASSERT(static_cast<float> (flaps) > 0.4f);
+
+		// Three frames after the one it started waiting in.
+		xplm_mock::run_frame();
+		xplm_mock::run_frame();
+		DATAREFW_ASSERT(seq.steps == 1);
+		xplm_mock::run_frame();
+		DATAREFW_ASSERT(seq.steps == 2 && static_cast<float> (flaps) > 0.9f);
+		DATAREFW_ASSERT(scheduler.waiting() == 2 && scheduler.frame() == 5);
+
+		// Unspawned tasks and tasks still waiting are freed, not run.
+		{
+			coro_trace unspawned;
+			auto task = coro_watch_gear(gear, unspawned);
+			DATAREFW_UNUSED(task);
+		}
+		DATAREFW_ASSERT(!watch_a.destroyed);
+	}
+
+	DATAREFW_ASSERT(watch_a.destroyed && watch_b.destroyed && watch_a.steps == 1);
+
+	// The scheduler's flight loop went with it.
+	xplm_mock::reset_counters();
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(xplm_mock::counters().gets == 0);
+
+	FrameScheduler scheduler;
+
+	// Missing or mistyped datarefs resume at once with nothing, instead of
+	// asserting in the flight loop.
+	FindDataref<int> missing("test/sim/nothing");
+	coro_trace no_dr;
+	scheduler.spawn(coro_wait_for(missing, no_dr));
+	DATAREFW_ASSERT(no_dr.steps == 1 && no_dr.failed && scheduler.waiting() == 0);
+
+	FindDataref<float> mistyped("test/sim/late_int");
+	xplm_mock::add_int("test/sim/late_int", 3);
+	FindDataref<int> late_int("test/sim/late_int");
+	coro_trace wrong_type;
+	scheduler.spawn(coro_wait_for(mistyped, wrong_type));
+	DATAREFW_ASSERT(wrong_type.steps == 1 && wrong_type.failed);
+
+	// A waiter whose dataref goes away is resumed with nothing.
+	coro_trace dropped;
+	scheduler.spawn(coro_wait_for(gear, dropped));
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(dropped.steps == 0 && scheduler.waiting() == 1);
+	reset_dataref_registry();
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(dropped.steps == 1 && dropped.failed && scheduler.waiting() == 0);
+
+	// Array groups read into the same vector every frame.
+	const auto n1_ref = xplm_mock::add_float_array("test/sim/n1", 4);
+	FindDataref<DrFloatArr> n1("test/sim/n1");
+	coro_trace n1_trace;
+	scheduler.spawn(coro_wait_n1(n1, n1_trace));
+	xplm_mock::run_frame();
+	const std::size_t allocs_before = alloc_count;
+	for (int i = 0; i < 8; ++i) {
+		xplm_mock::run_frame();
+	}
+	DATAREFW_ASSERT(alloc_count == allocs_before);
+	float n1_vals[] = { 10.0f, 60.0f, 30.0f, 40.0f };
+	XPLMSetDatavf(n1_ref, n1_vals, 0, 4);
+	xplm_mock::run_frame();
+	DATAREFW_ASSERT(n1_trace.steps == 1 && n1_trace.gear_seen == 60);
+}
+#endif // DATAREFW_HAS_COROUTINES
+
+void
+test_dataref_registry() {
+	reset_host();
+	xplm_mock::add_float("test/sim/shared", 2.0f);
+
+	xplm_mock::reset_counters();
+	std::array<FindDataref<float>, 16> refs;
+	for (auto& r : refs) {
+		r.find_dataref("test/sim/shared");
+	}
+	FindDataref<float> other("test/sim/shared");
+	DatarefGroup group;
+	group.add<float>("test/sim/shared");
+
+	// One lookup, however many wrappers share the path.
+	DATAREFW_ASSERT(xplm_mock::counters().finds == 1);
+	DATAREFW_ASSERT(refs[7] > 1.5f);
+	DATAREFW_ASSERT(refs[3].path() == "test/sim/shared");
+
+	// Missing paths are retried, since another plugin can register them later.
+	FindDataref<int> early("test/sim/late");
+	DATAREFW_ASSERT(!early.found());
+	xplm_mock::add_int("test/sim/late", 5);
+	FindDataref<int> late("test/sim/late");
+	DATAREFW_ASSERT(late.found() && late == 5);
+	// Shares the record, so the early wrapper resolves too.
+	DATAREFW_ASSERT(early.found() && early == 5);
+
+	// A wrapper that resolves later is type and size checked on first use.
+	FindDataref<std::array<int, 4>> early_array("test/sim/late_array");
+	DATAREFW_ASSERT(!early_array.found());
+	xplm_mock::add_int_array("test/sim/late_array", 4);
+	FindDataref<std::array<int, 4>> late_array("test/sim/late_array");
+	const auto sizes = xplm_mock::counters().size_queries;
+	DATAREFW_ASSERT(early_array.found());
+	early_array.set(1, 9);
+	DATAREFW_ASSERT(xplm_mock::counters().size_queries == sizes + 1);
+	DATAREFW_ASSERT(early_array[1] == 9);
+	DATAREFW_ASSERT(xplm_mock::counters().size_queries == sizes + 1);
+
+	// Groups hold the records too, so they follow the registry reset.
+	DatarefGroup late_group;
+	const auto late_index = late_group.add<int>("test/sim/late");
+	late_group.refresh();
+	DATAREFW_ASSERT(late_group.get<int>(late_index) == 5);
+
+	reset_dataref_registry();
+	DATAREFW_ASSERT(!other.found());
+	DATAREFW_ASSERT(!group.found<float>(0));
+	DATAREFW_ASSERT(!late_group.found<int>(late_index));
+
+	FindDataref<int> again("test/sim/late");
+	late_group.refresh();
+	DATAREFW_ASSERT(late_group.found<int>(late_index));
+	DATAREFW_ASSERT(late_group.get<int>(late_index) == 5);
+	DATAREFW_ASSERT(late_group.path<int>(late_index) == "test/sim/late");
+}
+
+DATAREFW_PATH(static_ias_path, "test/sim/static_ias");
+DATAREFW_PATH(static_n1_path, "test/sim/static_n1");
+
+void
+test_static_paths() {
+	reset_host();
+
+	FindDataref<float, &static_ias_path::slot> missing;
+	DATAREFW_ASSERT(!missing.found());
+
+	xplm_mock::add_float("test/sim/static_ias", 120.0f);
+	xplm_mock::add_float_array("test/sim/static_n1", 4);
+
+	// Resolved once through the slot, every later wrapper just reads it.
+	xplm_mock::reset_counters();
+	for (int i = 0; i < 100; ++i) {
+		FindDataref<float, &static_ias_path::slot> ias;
+		DATAREFW_ASSERT(ias.found() && ias > 119.5f);
+	}
+	DATAREFW_ASSERT(xplm_mock::counters().finds == 1);
+	DATAREFW_ASSERT(missing.found());
+
+	FindDataref<std::array<float, 4>, &static_n1_path::slot> n1;
+	n1.set(2, 97.5f);
+	DATAREFW_ASSERT(n1[2] > 97.0f);
+	DATAREFW_ASSERT(n1.path() == "test/sim/static_n1");
+
+	// Same path given at runtime shares the record.
+	FindDataref<float> by_name("test/sim/static_ias");
+	DATAREFW_ASSERT(xplm_mock::counters().finds == 2);
+
+#ifdef DATAREFW_HAS_PATH_LITERALS
+	FindDataref<float, "test/sim/static_ias"_dr> literal;
+	DATAREFW_ASSERT(literal.found() && literal.path() == "test/sim/static_ias");
+	FindDataref<std::array<float, 4>, "test/sim/static_n1"_dr> literal_n1;
+	DATAREFW_ASSERT(literal_n1[2] > 97.0f);
+	DATAREFW_ASSERT(xplm_mock::counters().finds == 2);
+#endif // DATAREFW_HAS_PATH_LITERALS
+
+	// Handles dropped at plugin stop are looked up again.
+	reset_dataref_registry();
+	FindDataref<float, &static_ias_path::slot> after_reset;
+	DATAREFW_ASSERT(after_reset.found());
+}
+
+void
+test_call_stats() {
+	reset_host();
+	reset_dataref_call_stats();
+	xplm_mock::add_int("test/stats/int", 1);
+	xplm_mock::add_float_array("test/stats/floats", 8);
+	xplm_mock::add_data("test/stats/data", "hello");
+
+	FindDataref<int> find_int("test/stats/int");
+	FindDataref<int> same_int("test/stats/int");
+	FindDataref<DrFloatArr> find_floats("test/stats/floats");
+	FindDataref<std::array<float, 8>> fixed_floats("test/stats/floats");
+	FindDataref<std::string> find_data("test/stats/data");
+	FindDataref<int> missing("test/stats/missing");
+	missing.find_dataref("test/stats/missing");
+
+	int sum = 0;
+	for (int i = 0; i < 10; ++i) {
+		sum += find_int;
+	}
+	find_int = 5;
+	same_int.write_behind();
+	same_int = 6;
+	same_int = 7;
+	flush_writes();
+
+	DATAREFW_ASSERT(find_floats.size() == 8);
+	DATAREFW_ASSERT(find_floats.at(2) >= 0.0f);
+	const DrFloatArr floats = find_floats;
+	const auto fixed = fixed_floats.get();
+	const std::string data = find_data;
+	DATAREFW_ASSERT(sum == 10 && floats.size() == fixed.size() && data == "hello");
+
+	const auto stats = dataref_call_stats();
+	const auto row = [&stats](const char *path) -> const DatarefCallStats * {
+		for (const auto& r : stats) {
+			if (r.path == path) {
+				return &r;
+			}
+		}
+		return nullptr;
+	};
+
+#ifdef DATAREFW_INSTRUMENT
+	const auto int_row = row("test/stats/int");
+	DATAREFW_ASSERT(int_row != nullptr);
+	DATAREFW_ASSERT(int_row->lookups == 1 && int_row->gets == 10 && int_row->sets == 2);
+	DATAREFW_ASSERT(int_row->array_reads == 0 && int_row->size_queries == 0);
+
+	// size(), at() and the vector read each ask for the size, and so does the
+	// fixed-size wrapper once when it's found.
+	const auto float_row = row("test/stats/floats");
+	DATAREFW_ASSERT(float_row != nullptr);
+	DATAREFW_ASSERT(float_row->lookups == 1 && float_row->gets == 0);
+	DATAREFW_ASSERT(float_row->size_queries == 4 && float_row->array_reads == 3);
+
+	const auto data_row = row("test/stats/data");
+	DATAREFW_ASSERT(data_row != nullptr);
+	DATAREFW_ASSERT(data_row->size_queries == 1 && data_row->array_reads == 1);
+
+	// Paths that weren't found are looked up again every time.
+	const auto missing_row = row("test/stats/missing");
+	DATAREFW_ASSERT(missing_row != nullptr && missing_row->lookups == 2);
+	DATAREFW_ASSERT(missing_row->calls() == 2);
+
+	for (std::size_t i = 1; i < stats.size(); ++i) {
+		DATAREFW_ASSERT(stats[i - 1].nanoseconds >= stats[i].nanoseconds);
+	}
+#ifdef DATAREFW_INSTRUMENT_TIMING
+	DATAREFW_ASSERT(int_row->nanoseconds > 0);
+#else
+	DATAREFW_ASSERT(stats.front().path == "test/stats/int");
+#endif
+
+	const auto table = format_dataref_call_stats();
+	DATAREFW_ASSERT(table.find("test/stats/floats") != std::string::npos);
+	const auto top = format_dataref_call_stats(1);
+	DATAREFW_ASSERT(std::count(top.begin(), top.end(), '\n') == 3);
+	DATAREFW_ASSERT(top.find(stats.front().path) != std::string::npos);
+
+	dump_dataref_call_stats();
+	DATAREFW_ASSERT(xplm_mock::debug_output().find(table) != std::string::npos);
+
+	reset_dataref_call_stats();
+	DATAREFW_ASSERT(dataref_call_stats().empty());
+#else
+	DATAREFW_ASSERT(row("test/stats/int") == nullptr && stats.empty());
+	DATAREFW_ASSERT(format_dataref_call_stats().find("compiled out") != std::string::npos);
+#endif
+}
+
+void
+test_latency_histogram() {
+	LatencyHistogram hist;
+	DATAREFW_ASSERT(hist.count() == 0 && hist.percentile(0.5) == 0);
+
+	// Small values are exact.
+	hist.record(3);
+	DATAREFW_ASSERT(hist.percentile(0.5) == 3 && hist.max() == 3);
+
+	hist.reset();
+	for (std::uint64_t v = 1; v <= 1000; ++v) {
+		hist.record(v);
+	}
+	DATAREFW_ASSERT(hist.count() == 1000 && hist.sum() == 500500 && hist.max() == 1000);
+
+	// Never below the real value, and at most 12.5% above it.
+	const auto p50 = hist.percentile(0.5);
+	const auto p99 = hist.percentile(0.99);
+	DATAREFW_ASSERT(p50 >= 500 && p50 <= 563);
+	DATAREFW_ASSERT(p99 >= 990 && p99 <= 1000);
+	DATAREFW_ASSERT(hist.percentile(1.0) == 1000 && hist.percentile(0.0) == 1);
+
+	hist.record(std::numeric_limits<std::uint64_t>::max());
+	DATAREFW_ASSERT(hist.count() == 1001);
+	DATAREFW_ASSERT(hist.percentile(1.0) == (std::uint64_t(1) << LatencyHistogram::max_bits) - 1);
+}
+
+void
+test_callback_latency() {
+	reset_host();
+	reset_callback_latency_stats();
+
+	CreateDataref<float> own_float("test/latency/float", true);
+	CreateDataref<DrIntArr, 8> own_ints("test/latency/ints", true);
+	ComputedDataref<float> slow("test/latency/slow", [] {
+		const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+		while (std::chrono::steady_clock::now() < until) {}
+		return 1.0f;
+	});
+
+	FindDataref<float> find_float("test/latency/float");
+	FindDataref<DrIntArr> find_ints("test/latency/ints");
+	FindDataref<float> find_slow("test/latency/slow");
+
+	float sum = 0.0f;
+	for (int i = 0; i < 100; ++i) {
+		sum += find_float;
+	}
+	for (int i = 0; i < 10; ++i) {
+		find_float = static_cast<float> (i);
+	}
+	const std::array<int, 3> ints {{ 1, 2, 3 }};
+	find_ints.write_range(2, ints.size(), ints.data());
+	DATAREFW_ASSERT(find_ints.at(3) == 2);
+	for (int i = 0; i < 5; ++i) {
+		sum += find_slow;
+		xplm_mock::run_frame();
+	}
+	DATAREFW_ASSERT(sum > 4.0f);
+
+	const auto stats = callback_latency_stats();
+	const auto row = [&stats](const char *path) -> const CallbackLatencyStats * {
+		for (const auto& r : stats) {
+			if (r.path == path) {
+				return &r;
+			}
+		}
+		return nullptr;
+	};
+
+#ifdef DATAREFW_INSTRUMENT_CALLBACKS
+	const auto float_row = row("test/latency/float");
+	DATAREFW_ASSERT(float_row != nullptr);
+	DATAREFW_ASSERT(float_row->reads == 100 && float_row->writes == 10);
+	DATAREFW_ASSERT(float_row->reads_per_second > 0.0 && float_row->writes_per_second > 0.0);
+	DATAREFW_ASSERT(float_row->read_p50 <= float_row->read_p99);
+	DATAREFW_ASSERT(float_row->read_p99 <= float_row->read_max);
+
+	// at() asks for the size first, then reads the element.
+	const auto ints_row = row("test/latency/ints");
+	DATAREFW_ASSERT(ints_row != nullptr && ints_row->reads == 2 && ints_row->writes == 1);
+
+	// Five frames of a 50us compute outweigh everything else.
+	DATAREFW_ASSERT(stats.front().path == "test/latency/slow");
+	DATAREFW_ASSERT(stats.front().reads == 5 && stats.front().read_p50 >= 40000);
+
+	const auto table = format_callback_latency_stats(2);
+	DATAREFW_ASSERT(table.find("test/latency/slow") != std::string::npos);
+	DATAREFW_ASSERT(std::count(table.begin(), table.end(), '\n') == 4);
+
+	dump_callback_latency_stats();
+	DATAREFW_ASSERT(xplm_mock::debug_output().find("test/latency/ints") != std::string::npos);
+
+	reset_callback_latency_stats();
+	DATAREFW_ASSERT(callback_latency_stats().empty());
+#else
+	DATAREFW_ASSERT(row("test/latency/float") == nullptr && stats.empty());
+	DATAREFW_ASSERT(format_callback_latency_stats().find("compiled out") != std::string::npos);
+#endif
+}
+
+} // namespace
+
+int
+main() {
+	test_find_scalar();
+	test_create_and_find();
+	test_mock_counters();
+	test_frame_cache();
+	test_dataref_group();
+	test_read_into();
+	test_fixed_array();
+	test_ranges();
+	test_write_behind();
+	test_create_string_callbacks();
+	test_create_array_callbacks();
+	test_create_cross_type_arrays();
+	test_create_array_storage();
+	test_concurrent_create();
+	test_computed();
+	test_change_queue();
+	test_versions();
+	test_bulk_registry();
+	test_frame_ring();
+	test_recorder();
+	test_recording_file();
+	test_recording_replay();
+	test_codecs();
+	test_compressed_recording();
+	test_proxy();
+#ifdef DATAREFW_HAS_COROUTINES
+	test_coroutines();
+#endif
+	test_dataref_registry();
+	test_static_paths();
+	test_call_stats();
+	test_latency_histogram();
+	test_callback_latency();
+
+	std::printf("all mock tests passed\n");
+	return 0;
+}